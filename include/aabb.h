@@ -7,17 +7,17 @@
 class AABB {
  public:
   AABB();
-  AABB(const Vector4d &min, const Vector4d &max);
+  AABB(const Vector4r &min, const Vector4r &max);
   ~AABB() = default;
 
   static AABB Union(const AABB &lhs, const AABB &rhs);
-  static AABB Union(const AABB &lhs, const Vector4d &p);
+  static AABB Union(const AABB &lhs, const Vector4r &p);
 
-  Vector4d min() const { return min_; }
-  Vector4d max() const { return max_; }
+  Vector4r min() const { return min_; }
+  Vector4r max() const { return max_; }
 
  private:
-  Vector4d min_, max_;
+  Vector4r min_, max_;
 };
 
 inline std::ostream &operator<<(std::ostream &os, const AABB &aabb) {
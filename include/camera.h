@@ -6,28 +6,30 @@
 class Camera {
  public:
   Camera() = default;
-  Camera(const Vector3d &eye, const Vector3d &dir, const Vector3d &up,
-		 double speed = 0.01);
+  Camera(const Vector3r &eye, const Vector3r &dir, const Vector3r &up,
+		 Real speed = 0.01);
   ~Camera() = default;
 
-  void MoveForward(double delta_time);
-  void MoveBack(double delta_time);
-  void MoveLeft(double delta_time);
-  void MoveRight(double delta_time);
+  void MoveForward(Real delta_time);
+  void MoveBack(Real delta_time);
+  void MoveLeft(Real delta_time);
+  void MoveRight(Real delta_time);
   void Rotate(int offset_x, int offset_y);
+  // place the camera at eye looking at target, keeps the up vector
+  void LookAt(const Vector3r &eye, const Vector3r &target);
 
-  Vector3d* eye() { return &eye_; }
-  Matrix4d* view_matrix() { return &view_matrix_; }
+  Vector3r* eye() { return &eye_; }
+  Matrix4r* view_matrix() { return &view_matrix_; }
 
   void UpdateView() { view_matrix_.SetView(eye_, dir_, up_); }
 
  private:
-  Vector3d eye_;
-  Vector3d dir_;
-  Vector3d up_;
-  Matrix4d view_matrix_;
-  double pitch_, yaw_;
-  double speed_;
+  Vector3r eye_;
+  Vector3r dir_;
+  Vector3r up_;
+  Matrix4r view_matrix_;
+  Real pitch_, yaw_;
+  Real speed_;
 };
 
 #endif //SOFTRENDERER_INCLUDE_CAMERA_H_
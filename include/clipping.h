@@ -0,0 +1,60 @@
+#ifndef SOFTRENDERER_INCLUDE_CLIPPING_H_
+#define SOFTRENDERER_INCLUDE_CLIPPING_H_
+
+#include "aabb.h"
+#include "global_config.h"
+#include "matrix.h"
+#include "vertex.h"
+
+enum class ClipPlane {
+  kWZero,
+  kNear, kFar,
+  kLeft, kRight,
+  kTop, kBottom
+};
+const int kNumClipPlanes = 7;
+
+// outcode bits of the planes that are always clipped geometrically
+const int kDepthClipPlanes = (1 << static_cast<int>(ClipPlane::kWZero))
+	| (1 << static_cast<int>(ClipPlane::kNear)) | (1 << static_cast<int>(ClipPlane::kFar));
+
+const int kAllClipPlanes = (1 << kNumClipPlanes) - 1;
+const int kSideClipPlanes = (1 << static_cast<int>(ClipPlane::kLeft)) | (1 << static_cast<int>(ClipPlane::kRight))
+	| (1 << static_cast<int>(ClipPlane::kTop)) | (1 << static_cast<int>(ClipPlane::kBottom));
+
+// Triangles within this multiple of the view volume in x and y are not clipped
+// against the side planes, the rasterizer clamps them to the screen instead
+const Real kGuardBand = 2.0;
+
+// Each plane cuts at most one corner off a convex polygon, adding one vertex.
+// Rounding can leave lerped vertices on the wrong side of a later plane, so the
+// polygon gets twice that room and ClipWithPlane drops what would not fit.
+const int kMaxClipVertices = 2 * (3 + kNumClipPlanes);
+
+// A convex polygon in clip space, kept on the stack while a triangle is clipped
+struct ClipPolygon {
+  VertexOut v[kMaxClipVertices];
+  int size;
+};
+
+enum class ClipResult {
+  kRejected,    // outside one plane, the polygon is empty
+  kAccepted,    // no plane needed clipping, the polygon is the triangle
+  kClipped      // cut by at least one plane, the polygon may still be empty
+};
+
+// Whether box, in the space mvp transforms to clip space, lies entirely outside
+// one of the given planes. Nothing inside such a box can be visible.
+bool BoxOutsideFrustum(const AABB &box, const Matrix4r &mvp, int planes = kAllClipPlanes);
+
+// Clips a convex polygon against one plane, out may hold one vertex more than in.
+// Each vertex is classified once, vertices on the plane count as outside.
+void ClipWithPlane(ClipPlane plane, const ClipPolygon &in, ClipPolygon &out);
+
+// Homogeneous clipping of triangle p1 p2 p3 into polygon, which is empty when
+// the triangle is outside the view volume. With guard_band, triangles inside
+// the guard band are only clipped against w, near and far.
+ClipResult ClipTriangle(const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+						bool guard_band, ClipPolygon &polygon);
+
+#endif //SOFTRENDERER_INCLUDE_CLIPPING_H_
@@ -1,6 +1,7 @@
 #ifndef SOFTRENDERER_INCLUDE_FRAME_BUFFER_H_
 #define SOFTRENDERER_INCLUDE_FRAME_BUFFER_H_
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
@@ -11,46 +12,94 @@ class FrameBuffer {
   FrameBuffer(int width, int height);
   ~FrameBuffer() = default;
 
-  void ClearBuffer(const Vector4d &color);
-  void DrawPixel(int x, int y, const Vector4d &color);
-  double GetDepth(int x, int y);
-  void SetDepth(int x, int y, double depth);
+  void ClearBuffer(const Vector4r &color);
+  void DrawPixel(int x, int y, const Vector4r &color);
+  Real GetDepth(int x, int y);
+  void SetDepth(int x, int y, Real depth);
 
   int width() const { return width_; }
   int height() const { return height_; }
   unsigned char *color_buffer() { return color_buffer_.data(); }
+  Real *depth_buffer() { return depth_buffer_.data(); }
 
  private:
   int width_, height_, capacity_;
   std::vector<unsigned char> color_buffer_;
-  std::vector<double> depth_buffer_;
+  std::vector<Real> depth_buffer_;
+};
+
+// Storage of a shadow map, depths lie in [0, 1]
+enum class ShadowFormat {
+  kDepth16,    // unorm, 2 bytes per texel
+  kDepth32     // float, 4 bytes per texel
 };
 
 class ShadowBuffer {
  public:
-  ShadowBuffer(int width, int height);
+  ShadowBuffer(int width, int height, ShadowFormat format = ShadowFormat::kDepth32);
   ~ShadowBuffer() = default;
 
   void ClearBuffer();
-  double GetDepth(int x, int y);
-  void SetDepth(int x, int y, double depth);
+  // clears the inclusive rectangle, which must lie inside the buffer
+  void ClearRect(int x_min, int y_min, int x_max, int y_max);
+  Real GetDepth(int x, int y);
+  void SetDepth(int x, int y, Real depth);
 
   int width() const { return width_; }
   int height() const {return height_; }
-  unsigned char *shadow_texture() {
-    for (int i = 0; i < capacity_; i++) {
-      int j = 3 * i;
-	  shadow_texture_[j] = static_cast<unsigned char>(shadow_buffer_[i] * 255.0);
-	  shadow_texture_[j + 1] = static_cast<unsigned char>(shadow_buffer_[i] * 255.0);
-	  shadow_texture_[j + 2] = static_cast<unsigned char>(shadow_buffer_[i] * 255.0);
-    }
-    return shadow_texture_.data();
-  }
+  ShadowFormat format() const { return format_; }
+  // grey RGB image of the depths for debugging, allocated by the first call
+  unsigned char *shadow_texture();
 
  private:
   int width_, height_, capacity_;
-  std::vector<double> shadow_buffer_;
+  ShadowFormat format_;
+  std::vector<uint16_t> depth16_;    // only the vector of format_ is allocated
+  std::vector<float> depth32_;
   std::vector<unsigned char> shadow_texture_;
 };
 
+// Surface attributes of the nearest fragment of every pixel, written by the
+// geometry pass of deferred shading and read back by its lighting pass. Only
+// pixels whose depth was written this frame hold valid values.
+// Position and normal drop w, which is 1 and 0. Albedo is a texture sample, so
+// it is kept as 8-bit RGBA, w being 0 or 1 for meshes without a texture.
+// 2 * 3 Reals and 4 bytes: 52 bytes per pixel in the double build, 28 with floats.
+class GBuffer {
+ public:
+  GBuffer(int width, int height);
+  ~GBuffer() = default;
+
+  void Write(int x, int y, const Vector4r &position, const Vector4r &normal, const Vector4r &albedo) {
+	int index = y * width_ + x;
+	position_[index] = position;
+	normal_[index] = normal;
+	unsigned char *rgba = albedo_.data() + 4 * index;
+	rgba[0] = static_cast<unsigned char>(albedo.x);
+	rgba[1] = static_cast<unsigned char>(albedo.y);
+	rgba[2] = static_cast<unsigned char>(albedo.z);
+	rgba[3] = static_cast<unsigned char>(albedo.w);
+  }
+  Vector4r position(int x, int y) const {
+	const Vector3r &p = position_[y * width_ + x];
+	return Vector4r(p.x, p.y, p.z, 1.0);
+  }
+  Vector4r normal(int x, int y) const {
+	const Vector3r &n = normal_[y * width_ + x];
+	return Vector4r(n.x, n.y, n.z, 0.0);
+  }
+  Vector4r albedo(int x, int y) const {
+	const unsigned char *rgba = albedo_.data() + 4 * (y * width_ + x);
+	return Vector4r(rgba[0], rgba[1], rgba[2], rgba[3]);
+  }
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+ private:
+  int width_, height_;
+  std::vector<Vector3r> position_, normal_;
+  std::vector<unsigned char> albedo_;    // rgba per pixel
+};
+
 #endif //SOFTRENDERER_INCLUDE_FRAME_BUFFER_H_
@@ -1,6 +1,18 @@
 #ifndef SOFTRENDERER_INCLUDE_GLOBAL_CONFIG_H_
 #define SOFTRENDERER_INCLUDE_GLOBAL_CONFIG_H_
 
-enum class RenderMode { kLine, kFull, kPBR };
+// Scalar type of the render pipeline. Double is the reference path, building
+// with SOFTRENDERER_USE_FLOAT halves the memory traffic and doubles SIMD width.
+#ifdef SOFTRENDERER_USE_FLOAT
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
+// kDeferred lights like kFull, but only once per pixel from a G-buffer
+enum class RenderMode { kLine, kFull, kPBR, kDeferred };
+
+// instruction set used by the triangle rasterizer
+enum class SimdLevel { kScalar, kSSE2, kAVX2 };
 
 #endif //SOFTRENDERER_INCLUDE_GLOBAL_CONFIG_H_
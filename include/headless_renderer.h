@@ -0,0 +1,62 @@
+#ifndef SOFTRENDERER_INCLUDE_HEADLESS_RENDERER_H_
+#define SOFTRENDERER_INCLUDE_HEADLESS_RENDERER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "global_config.h"
+#include "matrix.h"
+#include "pipeline.h"
+#include "scene.h"
+
+enum class ImageFormat { kPNG, kPPM, kRaw };
+
+// A camera key frame, the camera sits at eye and looks at target
+struct CameraKey {
+  Vector3r eye, target;
+};
+
+// Reads one key frame per line, "eye_x eye_y eye_z target_x target_y target_z".
+// Blank lines and lines starting with # are skipped.
+bool LoadCameraPath(const std::string &path, std::vector<CameraKey> &keys);
+
+// Writes an RGBA8 image to an open stream. PNG and PPM drop alpha, raw keeps all
+// four channels with no header, so raw and PPM frames can be concatenated into a pipe.
+bool WriteImage(FILE *stream, ImageFormat format, const unsigned char *rgba, int width, int height);
+
+// Renders a scene into the pipeline's frame buffers without a window, the
+// counterpart of Window for batch rendering
+class HeadlessRenderer {
+ public:
+  HeadlessRenderer(int width, int height);
+  ~HeadlessRenderer();
+
+  void LoadScene(const std::string &base_path);
+  void SwitchRenderMode(RenderMode mode);
+  // key frames are spread evenly over the frames, an empty path keeps the scene camera
+  void set_camera_path(const std::vector<CameraKey> &keys) { camera_path_ = keys; }
+
+  // renders frame out of num_frames and returns its RGBA8 color buffer
+  unsigned char *RenderFrame(int frame, int num_frames);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  Pipeline *pipeline() { return pipeline_; }
+
+ private:
+  void SetCamera(int frame, int num_frames);
+  void SetLights();
+  void SetMeshes();
+
+ private:
+  int width_, height_;
+  Pipeline *pipeline_;
+  Scene *scene_;
+  RenderMode mode_;
+  Matrix4r project_matrix_;
+  std::vector<CameraKey> camera_path_;
+};
+
+#endif //SOFTRENDERER_INCLUDE_HEADLESS_RENDERER_H_
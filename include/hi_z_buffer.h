@@ -0,0 +1,44 @@
+#ifndef SOFTRENDERER_INCLUDE_HI_Z_BUFFER_H_
+#define SOFTRENDERER_INCLUDE_HI_Z_BUFFER_H_
+
+#include <vector>
+
+#include "global_config.h"
+
+// Occlusion tests only pass when the nearest depth is behind by more than this,
+// interpolated depths can round slightly below those of their vertices
+const Real kHiZMargin = 1e-5;
+
+// Nearest and farthest depth of every kBlockSize square of a depth buffer, one
+// level above the per-pixel test. Anything whose nearest depth lies behind the
+// farthest depth of every block it overlaps fails the depth test at each of its
+// pixels, so it can be skipped without being rasterized.
+// Writes only lower the nearest depth and mark the block, its farthest depth is
+// rescanned when a test needs it. A test against a block whose nearest depth is
+// already behind the tested one fails without a rescan.
+// Tiles cover whole blocks, so concurrent tiles never touch the same block.
+class HiZBuffer {
+ public:
+  static const int kBlockSize = 8;
+
+  HiZBuffer(int width, int height);
+  ~HiZBuffer() = default;
+
+  // rescans every block overlapping the inclusive rectangle
+  void Reset(const Real *depth_buffer, int x_min, int y_min, int x_max, int y_max);
+  // records depths no nearer than min_depth written inside the rectangle
+  void Write(Real min_depth, int x_min, int y_min, int x_max, int y_max);
+  // true when min_depth is behind every block of the rectangle, an empty one hides nothing
+  bool Occluded(const Real *depth_buffer, Real min_depth, int x_min, int y_min, int x_max, int y_max);
+
+ private:
+  void Rescan(const Real *depth_buffer, int bx, int by);
+
+ private:
+  int width_, height_;
+  int num_x_, num_y_;
+  std::vector<Real> min_depth_, max_depth_;
+  std::vector<char> dirty_;    // max_depth_ is stale
+};
+
+#endif //SOFTRENDERER_INCLUDE_HI_Z_BUFFER_H_
@@ -12,167 +12,201 @@ enum class LightType {
 
 class Light {
  public:
-  Light(const Vector4d &light_pos = Vector4d{},
-		const Vector4d &light_color = Vector4d(2.0, 2.0, 2.0),
-		const Vector4d &ambient = Vector4d(0.2, 0.2, 0.2),
-		const Vector4d &diffuse = Vector4d(0.5, 0.5, 0.5),
-		const Vector4d &specular = Vector4d(1.0, 1.0, 1.0)) :
+  Light(const Vector4r &light_pos = Vector4r{},
+		const Vector4r &light_color = Vector4r(2.0, 2.0, 2.0),
+		const Vector4r &ambient = Vector4r(0.2, 0.2, 0.2),
+		const Vector4r &diffuse = Vector4r(0.5, 0.5, 0.5),
+		const Vector4r &specular = Vector4r(1.0, 1.0, 1.0)) :
 	  light_pos_(light_pos),
 	  light_color_(light_color),
 	  ambient_(ambient),
 	  diffuse_(diffuse),
-	  specular_(specular) {}
+	  specular_(specular),
+	  shadow_buffer_(nullptr),
+	  shadow_generation_(0),
+	  shadow_width_(0),
+	  shadow_height_(0),
+	  shadow_format_(ShadowFormat::kDepth32) {}
   virtual ~Light() { if (shadow_buffer_) delete shadow_buffer_; }
 
   // all the parameters are in world coordinates
-  virtual Vector4d Lighting(const Vector4d &normal,
-							const Vector4d &pos,
-							const Vector4d &view_pos,
-							const Vector4d &albedo,
+  virtual Vector4r Lighting(const Vector4r &normal,
+							const Vector4r &pos,
+							const Vector4r &view_pos,
+							const Vector4r &albedo,
 							bool occlude) = 0;
   // usedin pbr, all the parameters are in world coordinates
-  virtual Vector4d PBRLighting(const Vector4d &normal,
-							   const Vector4d &pos,
-							   const Vector4d &view_pos,
-							   const Vector4d &albedo,
+  virtual Vector4r PBRLighting(const Vector4r &normal,
+							   const Vector4r &pos,
+							   const Vector4r &view_pos,
+							   const Vector4r &albedo,
 							   bool occlude) = 0;
 
   LightType type() const { return type_; }
-  Vector4d light_pos() const { return light_pos_; }
-  void light_pos(const Vector4d &light_pos) { light_pos_ = light_pos; }
-  Matrix4d view_matrix() { return view_matrix_; }
-  void view_matrix(const Vector3d &pos,
-				   const Vector3d &dir,
-				   const Vector3d &up) { view_matrix_.SetView(pos, dir, up); }
-  Matrix4d project_matrix() { return project_matrix_; }
+  Vector4r light_pos() const { return light_pos_; }
+  void light_pos(const Vector4r &light_pos) { light_pos_ = light_pos; }
+  const Matrix4r &view_matrix() const { return view_matrix_; }
+  void view_matrix(const Vector3r &pos,
+				   const Vector3r &dir,
+				   const Vector3r &up) { view_matrix_.SetView(pos, dir, up); }
+  const Matrix4r &project_matrix() const { return project_matrix_; }
   void project_matrix(const std::vector<Mesh *> &meshes) {
 	AABB aabb;
-	Matrix4d mat;
-	for (int i = 0; i < meshes.size(); i++) {
-	  mat = view_matrix_ * meshes[i]->model_matrix;
-	  for (int j = 0; j < meshes[i]->vertices.size(); j++) {
-		aabb = AABB::Union(aabb, mat * meshes[i]->vertices[j].local_position);
-	  }
-	}
-	light_pos_ = Vector4d((aabb.min().x + aabb.max().x) / 2.0,
+	for (int i = 0; i < meshes.size(); i++)
+	  aabb = AABB::Union(aabb, ViewBounds(meshes[i]));
+	project_matrix(aabb);
+  }
+  // bounds of the mesh's vertices in the light's view space
+  AABB ViewBounds(const Mesh *mesh) const {
+	AABB aabb;
+	Matrix4r mat = view_matrix_ * mesh->model_matrix;
+	for (int j = 0; j < mesh->vertices.size(); j++)
+	  aabb = AABB::Union(aabb, mat * mesh->vertices[j].local_position);
+	return aabb;
+  }
+  // Fits the orthographic projection to view space bounds and moves the light
+  // onto their near face. The bounds are taken with the light at the origin.
+  void project_matrix(const AABB &aabb) {
+	light_pos_ = Vector4r((aabb.min().x + aabb.max().x) / 2.0,
 						  (aabb.min().y + aabb.max().y) / 2.0,
 						  aabb.max().z,
 						  1.0);
 	light_pos_ = view_matrix_.InverseHomo() * light_pos_;
-	Vector3d pos = Vector3d(light_pos_.x, light_pos_.y, light_pos_.z);
-	Vector3d dir = Vector3d(light_dir().x, light_dir().y, light_dir().z);
-	view_matrix_.SetView(pos, dir.Normalize(), Vector3d(0.0, 1.0, 0.0));
+	Vector3r pos = Vector3r(light_pos_.x, light_pos_.y, light_pos_.z);
+	Vector3r dir = Vector3r(light_dir().x, light_dir().y, light_dir().z);
+	view_matrix_.SetView(pos, dir.Normalize(), Vector3r(0.0, 1.0, 0.0));
 
-	double x_size = aabb.max().x - aabb.min().x;
-	double y_size = aabb.max().y - aabb.min().y;
-	double z_size = aabb.max().z - aabb.min().z;
+	Real x_size = aabb.max().x - aabb.min().x;
+	Real y_size = aabb.max().y - aabb.min().y;
+	Real z_size = aabb.max().z - aabb.min().z;
 	project_matrix_.SetOrtho(x_size / 2, y_size / 2, 0.0, -z_size);
   }
+  // Maps a world position to shadow map pixels and depth. Baked once per frame
+  // after the view and project matrices are set, so shading does one product.
+  const Matrix4r &shadow_matrix() const { return shadow_matrix_; }
+  void shadow_matrix(const Matrix4r &viewport_matrix) {
+	shadow_matrix_ = viewport_matrix * project_matrix_ * view_matrix_;
+  }
   ShadowBuffer *shadow_buffer() { return shadow_buffer_; }
-  void shadow_buffer(int width, int height) { shadow_buffer_ = new ShadowBuffer(width, height); }
-  virtual Vector4d light_dir() const = 0;
+  void shadow_buffer(int width, int height) {
+	if (shadow_buffer_) delete shadow_buffer_;
+	shadow_buffer_ = new ShadowBuffer(width, height, shadow_format_);
+	shadow_generation_++;
+  }
+  // counts the shadow buffer allocations, a new buffer may reuse the old address
+  unsigned shadow_generation() const { return shadow_generation_; }
+  // shadow map size and storage the scene asks for, a size of 0 follows the frame size
+  int shadow_width() const { return shadow_width_; }
+  int shadow_height() const { return shadow_height_; }
+  void shadow_resolution(int width, int height) { shadow_width_ = width, shadow_height_ = height; }
+  ShadowFormat shadow_format() const { return shadow_format_; }
+  void shadow_format(ShadowFormat format) { shadow_format_ = format; }
+  virtual Vector4r light_dir() const = 0;
 
  protected:
   // normal distribution function
-  double NDF(const Vector4d &n, const Vector4d &h, double roughness);
+  Real NDF(const Vector4r &n, const Vector4r &h, Real roughness);
   // fresnel function
-  Vector4d FE(const Vector4d &f0, const Vector4d &h, const Vector4d &v);
+  Vector4r FE(const Vector4r &f0, const Vector4r &h, const Vector4r &v);
   // geometry function
-  double GE(const Vector4d &n, const Vector4d &v, const Vector4d &l, double roughness);
+  Real GE(const Vector4r &n, const Vector4r &v, const Vector4r &l, Real roughness);
 
  private:
-  double GESub(double n_dot_v, double roughness);
+  Real GESub(Real n_dot_v, Real roughness);
 
  protected:
-  Vector4d light_pos_, light_color_;
-  Vector4d ambient_, diffuse_, specular_;
+  Vector4r light_pos_, light_color_;
+  Vector4r ambient_, diffuse_, specular_;
   LightType type_;
   ShadowBuffer *shadow_buffer_;    // shadow map
-  Matrix4d view_matrix_, project_matrix_;
+  unsigned shadow_generation_;
+  int shadow_width_, shadow_height_;
+  ShadowFormat shadow_format_;
+  Matrix4r view_matrix_, project_matrix_, shadow_matrix_;
 };
 
 class DirectionLight : public Light {
  public:
-  DirectionLight(const Vector4d &light_dir)
+  DirectionLight(const Vector4r &light_dir)
 	  : light_dir_(light_dir.Normalize()) { type_ = LightType::kDir; }
   ~DirectionLight() = default;
 
-  virtual Vector4d Lighting(const Vector4d &normal,
-							const Vector4d &pos,
-							const Vector4d &view_pos,
-							const Vector4d &albedo,
+  virtual Vector4r Lighting(const Vector4r &normal,
+							const Vector4r &pos,
+							const Vector4r &view_pos,
+							const Vector4r &albedo,
 							bool occlude) override;
-  virtual Vector4d PBRLighting(const Vector4d &normal,
-							   const Vector4d &pos,
-							   const Vector4d &view_pos,
-							   const Vector4d &albedo,
+  virtual Vector4r PBRLighting(const Vector4r &normal,
+							   const Vector4r &pos,
+							   const Vector4r &view_pos,
+							   const Vector4r &albedo,
 							   bool occlude) override;
 
-  virtual Vector4d light_dir() const override { return light_dir_; }
+  virtual Vector4r light_dir() const override { return light_dir_; }
 
  private:
-  Vector4d light_dir_;    // inverse direction
+  Vector4r light_dir_;    // inverse direction
 };
 
 class PointLight : public Light {
  public:
-  PointLight(const Vector4d &light_pos,
-			 double constant = 1.0,
-			 double linear = 0.09,
-			 double quadratic = 0.032)
+  PointLight(const Vector4r &light_pos,
+			 Real constant = 1.0,
+			 Real linear = 0.09,
+			 Real quadratic = 0.032)
 	  : Light(light_pos),
 		constant_(constant),
 		linear_(linear),
 		quadratic_(quadratic) { type_ = LightType::kPoint; }
   ~PointLight() = default;
 
-  virtual Vector4d Lighting(const Vector4d &normal,
-							const Vector4d &pos,
-							const Vector4d &view_pos,
-							const Vector4d &albedo,
+  virtual Vector4r Lighting(const Vector4r &normal,
+							const Vector4r &pos,
+							const Vector4r &view_pos,
+							const Vector4r &albedo,
 							bool occlude) override;
-  virtual Vector4d PBRLighting(const Vector4d &normal,
-							   const Vector4d &pos,
-							   const Vector4d &view_pos,
-							   const Vector4d &albedo,
+  virtual Vector4r PBRLighting(const Vector4r &normal,
+							   const Vector4r &pos,
+							   const Vector4r &view_pos,
+							   const Vector4r &albedo,
 							   bool occlude) override;
 
   // do not use
-  virtual Vector4d light_dir() const override { return Vector4d{}; }
+  virtual Vector4r light_dir() const override { return Vector4r{}; }
 
  private:
-  double constant_, linear_, quadratic_;
+  Real constant_, linear_, quadratic_;
 };
 
 class SpotLight : public Light {
  public:
-  SpotLight(const Vector4d &light_pos,
-			const Vector4d &spot_dir,
-			double inner_cutoff = 12.5,
-			double outer_cutoff = 17.5)
+  SpotLight(const Vector4r &light_pos,
+			const Vector4r &spot_dir,
+			Real inner_cutoff = 12.5,
+			Real outer_cutoff = 17.5)
 	  : Light(light_pos),
 		spot_dir_(spot_dir.Normalize()),
 		inner_cutoff_(std::cos(inner_cutoff)),
 		outer_cutoff_(std::cos(outer_cutoff)) { type_ = LightType::kSpot; }
   ~SpotLight() = default;
 
-  virtual Vector4d Lighting(const Vector4d &normal,
-							const Vector4d &pos,
-							const Vector4d &view_pos,
-							const Vector4d &albedo,
+  virtual Vector4r Lighting(const Vector4r &normal,
+							const Vector4r &pos,
+							const Vector4r &view_pos,
+							const Vector4r &albedo,
 							bool occlude) override;
-  virtual Vector4d PBRLighting(const Vector4d &normal,
-							   const Vector4d &pos,
-							   const Vector4d &view_pos,
-							   const Vector4d &albedo,
+  virtual Vector4r PBRLighting(const Vector4r &normal,
+							   const Vector4r &pos,
+							   const Vector4r &view_pos,
+							   const Vector4r &albedo,
 							   bool occlude) override;
 
   // do not use
-  virtual Vector4d light_dir() const override { return Vector4d{}; }
+  virtual Vector4r light_dir() const override { return Vector4r{}; }
 
  private:
-  Vector4d spot_dir_;    // inverse direction
-  double inner_cutoff_, outer_cutoff_;
+  Vector4r spot_dir_;    // inverse direction
+  Real inner_cutoff_, outer_cutoff_;
 };
 
 #endif //SOFTRENDERER_INCLUDE_LIGHT_H_
@@ -0,0 +1,32 @@
+#ifndef SOFTRENDERER_INCLUDE_MAPPED_FILE_H_
+#define SOFTRENDERER_INCLUDE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read-only into memory
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // empty files open successfully with data() == nullptr
+  bool Open(const std::string &path);
+  void Close();
+
+  const char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  const char *data_;
+  std::size_t size_;
+#ifdef _WIN32
+  void *file_, *mapping_;
+#else
+  int fd_;
+#endif
+};
+
+#endif //SOFTRENDERER_INCLUDE_MAPPED_FILE_H_
@@ -1,14 +1,20 @@
 #ifndef SOFTRENDERER_INCLUDE_MATH_UTIL_H_
 #define SOFTRENDERER_INCLUDE_MATH_UTIL_H_
 
+#include <algorithm>
+#include <type_traits>
+
 #include "vector.h"
 
 const double kPI = 3.14159265358979323846;
 
 inline double Radian(double angle) { return kPI * angle / 180.0; }
+inline double Degree(double radian) { return radian * 180.0 / kPI; }
 
+// the bounds take the element type, so literals work for any T
 template <typename T>
-inline void Clamp(Vector4<T> &vec, T min, T max) {
+inline void Clamp(Vector4<T> &vec, typename std::common_type<T>::type min,
+				  typename std::common_type<T>::type max) {
   vec.x = std::max(std::min(max, vec.x), min);
   vec.y = std::max(std::min(max, vec.y), min);
   vec.z = std::max(std::min(max, vec.z), min);
@@ -16,7 +22,8 @@ inline void Clamp(Vector4<T> &vec, T min, T max) {
 }
 
 template <typename T>
-inline void Clamp(T &num, T min, T max) {
+inline void Clamp(T &num, typename std::common_type<T>::type min,
+				  typename std::common_type<T>::type max) {
   num = std::max(std::min(max, num), min);
 }
 
@@ -83,7 +83,7 @@ class Matrix4 {
 	return *this;
   }
 
-  Matrix4 operator*(const Matrix4 &rhs) {
+  Matrix4 operator*(const Matrix4 &rhs) const {
 	T a00 = data[0][0] * rhs(0, 0) + data[0][1] * rhs(1, 0) +
 		data[0][2] * rhs(2, 0) + data[0][3] * rhs(3, 0);
 	T a01 = data[0][0] * rhs(0, 1) + data[0][1] * rhs(1, 1) +
@@ -134,6 +134,15 @@ class Matrix4 {
 		data[3][3] * rhs.w;
 	return Vector4<T>(x, y, z, w);
   }
+  bool operator==(const Matrix4 &rhs) const {
+	for (int i = 0; i < 4; i++) {
+	  for (int j = 0; j < 4; j++) {
+		if (data[i][j] != rhs.data[i][j]) return false;
+	  }
+	}
+	return true;
+  }
+  bool operator!=(const Matrix4 &rhs) const { return !(*this == rhs); }
 
   T operator()(int x, int y) const { return data[x][y]; }
 
@@ -194,8 +203,8 @@ class Matrix4 {
 	data[1][0] = -data[0][1];
 	data[1][1] = data[0][0];
   }
-  void SetRotationAxis(double angle, const Vector3d &axis) {
-	Vector3d u = axis.Normalize();
+  void SetRotationAxis(double angle, const Vector3<T> &axis) {
+	Vector3<T> u = axis.Normalize();
 
 	double cos_theta = cos(kPI * angle / 180.0);
 	double sin_theta = sin(kPI * angle / 180.0);
@@ -212,14 +221,14 @@ class Matrix4 {
 	data[2][1] = u.y * u.z * (1.0 - cos_theta) + u.x * sin_theta;
 	data[2][2] = u.z * u.z * (1.0 - cos_theta) + cos_theta;
   }
-  void SetView(const Vector3d &eye, const Vector3d &z_axis, const Vector3d &up) {
+  void SetView(const Vector3<T> &eye, const Vector3<T> &z_axis, const Vector3<T> &up) {
 	// dir and up are unit vectors
 	SetIdentity();
 
-	// Vector3d z_axis = eye - target;
-	Vector3d x_axis = up.Cross(z_axis);
+	// Vector3<T> z_axis = eye - target;
+	Vector3<T> x_axis = up.Cross(z_axis);
 	x_axis = x_axis.Normalize();
-	Vector3d y_axis = z_axis.Cross(x_axis);
+	Vector3<T> y_axis = z_axis.Cross(x_axis);
 	y_axis = y_axis.Normalize();
 
 	data[0][0] = x_axis.x;
@@ -256,7 +265,7 @@ class Matrix4 {
 	data[3][2] = -1;
   }
   Matrix4 Inverse() const {
-	double det;
+	T det;
 	Matrix4 adjoint_matrix = AdjointMatrix();
 
 	det = data[0][0] * adjoint_matrix(0, 0) + data[0][1] * adjoint_matrix(1, 0)
@@ -416,7 +425,7 @@ class Matrix4 {
 	return t_matrix;
   }
 
-  void SetMatrix(const Vector3d &v1, const Vector3d &v2, const Vector3d &v3) {
+  void SetMatrix(const Vector3<T> &v1, const Vector3<T> &v2, const Vector3<T> &v3) {
     data[0][0] = v1.x;
     data[1][0] = v1.y;
     data[2][0] = v1.z;
@@ -458,5 +467,6 @@ inline std::ostream &operator<<(std::ostream &os, const Matrix4<T> &rhs) {
 using Matrix4d = Matrix4<double>;
 using Matrix4f = Matrix4<float>;
 using Matrix4i = Matrix4<int>;
+using Matrix4r = Matrix4<Real>;
 
 #endif //SOFTRENDERER_INCLUDE_MATRIX_H_
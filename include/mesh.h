@@ -5,10 +5,43 @@
 #include <vector>
 
 #include "aabb.h"
+#include "mapped_file.h"
 #include "matrix.h"
 #include "texture.h"
 #include "vertex.h"
 
+// Read-only elements that either live in an owned vector or point straight
+// into a file mapping, so cached meshes are used without copying
+template<typename T>
+class MeshArray {
+ public:
+  MeshArray() : data_(nullptr), size_(0) {}
+  MeshArray(const MeshArray &) = delete;
+  MeshArray &operator=(const MeshArray &) = delete;
+
+  void Assign(std::vector<T> &&elements) {
+	owned_ = std::move(elements);
+	data_ = owned_.data();
+	size_ = owned_.size();
+  }
+  // data must outlive the array
+  void View(const T *data, std::size_t size) {
+	owned_.clear();
+	data_ = data;
+	size_ = size;
+  }
+
+  const T &operator[](std::size_t i) const { return data_[i]; }
+  const T *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  std::vector<T> owned_;
+  const T *data_;
+  std::size_t size_;
+};
+
 class Mesh {
  public:
   Mesh() { model_matrix.SetIdentity(); }
@@ -19,22 +52,26 @@ class Mesh {
   void LoadNormalTexture(const std::string &path);
   void LoadAABB();
 
-  void set_model_matrix(const Matrix4d &model) { model_matrix = model; }
+  void set_model_matrix(const Matrix4r &model) { model_matrix = model; }
 
   AABB aabb() { return aabb_; }
   void aabb(const AABB &aabb) { aabb_ = aabb; }
+  // bounds of the vertices in model space
+  AABB local_aabb() const { return local_aabb_; }
 
  private:
-  std::vector<std::string> Split(const std::string &str, const std::string &delimiter = "/");
+  bool LoadMeshCache(const std::string &obj_path, const std::string &cache_path);
+  void WriteMeshCache(const std::string &obj_path, const std::string &cache_path);
 
  public:
-  std::vector<VertexIn> vertices;
-  std::vector<int> indices;
+  MeshArray<VertexIn> vertices;
+  MeshArray<int> indices;
   Texture albedo_texture, normal_texture;
-  Matrix4d model_matrix;
+  Matrix4r model_matrix;
 
  private:
-  AABB aabb_;
+  AABB aabb_, local_aabb_;
+  MappedFile cache_file_;
 };
 
 #endif //SOFTRENDERER_INCLUDE_MESH_H_
@@ -0,0 +1,30 @@
+#ifndef SOFTRENDERER_INCLUDE_OBJ_PARSER_H_
+#define SOFTRENDERER_INCLUDE_OBJ_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "vector.h"
+
+// 0-based attribute indices of a face corner, -1 when the face leaves one out
+struct ObjCorner {
+  int position, texcoord, normal;
+};
+
+// Geometry of an OBJ file, faces are triangulated so every 3 corners form a triangle
+struct ObjData {
+  std::vector<Vector4r> positions;
+  std::vector<Vector2r> texcoords;
+  std::vector<Vector4r> normals;
+  std::vector<ObjCorner> corners;
+  std::size_t file_size = 0;
+};
+
+// Parses the v, vt, vn and f statements of an OBJ file through a memory mapping.
+// Polygons are split into fans and negative (relative) indices are resolved.
+// Files larger than a few MB are split at line breaks and parsed on up to
+// num_threads threads, num_threads <= 0 uses every hardware thread.
+// Returns false when the file cannot be read.
+bool ParseObjFile(const std::string &path, ObjData &data, int num_threads = 0);
+
+#endif //SOFTRENDERER_INCLUDE_OBJ_PARSER_H_
@@ -0,0 +1,25 @@
+#ifndef SOFTRENDERER_INCLUDE_PATH_PATTERN_H_
+#define SOFTRENDERER_INCLUDE_PATH_PATTERN_H_
+
+#include <string>
+
+// A file name with one number in it, such as frame_%04d.png. The field is %d or
+// %0Nd and %% is a percent sign. The text is never handed to printf.
+class PathPattern {
+ public:
+  PathPattern() : width_(0) {}
+  ~PathPattern() = default;
+
+  // false unless text has exactly one field and no other conversion
+  bool Parse(const std::string &text);
+  // the path with number in the field, zero padded to the field width
+  std::string Format(int number) const;
+
+  static const int kMaxWidth = 64;
+
+ private:
+  std::string prefix_, suffix_;    // around the field, %% already unescaped
+  int width_;
+};
+
+#endif //SOFTRENDERER_INCLUDE_PATH_PATTERN_H_
@@ -1,24 +1,105 @@
 #ifndef SOFTRENDERER_INCLUDE_PIPELINE_H_
 #define SOFTRENDERER_INCLUDE_PIPELINE_H_
 
+#include <chrono>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "camera.h"
+#include "clipping.h"
 #include "global_config.h"
 #include "shader.h"
 #include "shadow_map.h"
 #include "skybox.h"
 #include "frame_buffer.h"
+#include "hi_z_buffer.h"
 #include "matrix.h"
 #include "mesh.h"
+#include "raster_simd.h"
+#include "rasterizer.h"
 #include "texture.h"
+#include "thread_pool.h"
+#include "tile_grid.h"
 #include "vertex.h"
 
-enum class ClipPlane {
-  kWZero,
-  kNear, kFar,
-  kLeft, kRight,
-  kTop, kBottom
+// Vertices shaded by one thread pool job in the vertex stage
+const int kVertexBatchSize = 1024;
+
+// Wall time of each stage in milliseconds, summed over the frames drawn since
+// the last reset while stage timing is on
+struct StageTimes {
+  double clear = 0, vertex = 0, clip = 0, raster = 0, fragment = 0, shadow = 0;
+};
+
+// Only every n-th fragment shader call is timed, timing each one costs about
+// as much as a simple shader
+const int kFragmentTimingStride = 16;
+
+// Counters of the triangles and pixels that went through one Draw. With the
+// depth pre-pass the pixel counters describe the shading pass only.
+struct PipelineStatistics {
+  int64_t meshes_culled = 0;           // bounding box outside the view frustum
+  int64_t vertices_shaded = 0;
+  int64_t triangles_submitted = 0;     // triangles in the index buffers
+  int64_t backface_culled = 0;
+  int64_t trivially_rejected = 0;      // all vertices outside one clip plane
+  int64_t triangles_clipped = 0;       // cut by at least one plane
+  int64_t clip_triangles_generated = 0;  // fan triangles the clipped polygons were split into
+  int64_t triangles_rasterized = 0;    // sent to the back-end
+  int64_t triangles_occluded = 0;      // skipped by the hierarchical z test, once per tile
+  int64_t pixels_tested = 0;           // covered pixels that reached the depth test
+  int64_t depth_passed = 0, depth_failed = 0;
+  int64_t fragments_shaded = 0;
+  int64_t pixels_covered = 0;          // pixels with depth written at the end of the frame
+
+  PipelineStatistics &operator+=(const PipelineStatistics &other) {
+	meshes_culled += other.meshes_culled;
+	vertices_shaded += other.vertices_shaded;
+	triangles_submitted += other.triangles_submitted;
+	backface_culled += other.backface_culled;
+	trivially_rejected += other.trivially_rejected;
+	triangles_clipped += other.triangles_clipped;
+	clip_triangles_generated += other.clip_triangles_generated;
+	triangles_rasterized += other.triangles_rasterized;
+	triangles_occluded += other.triangles_occluded;
+	pixels_tested += other.pixels_tested;
+	depth_passed += other.depth_passed;
+	depth_failed += other.depth_failed;
+	fragments_shaded += other.fragments_shaded;
+	pixels_covered += other.pixels_covered;
+	return *this;
+  }
+
+  // shaded fragments per covered pixel, 1 means no fragment was wasted
+  double overdraw() const {
+	return pixels_covered > 0 ? static_cast<double>(fragments_shaded) / pixels_covered : 0.0;
+  }
+};
+
+// Back-end counters and time of one tile, merged into the frame totals afterwards.
+// The fragment share of the time is extrapolated from the timed shader calls.
+struct TileStats {
+  int64_t triangles_occluded;
+  int64_t pixels_tested, depth_passed, fragments_shaded, pixels_covered;
+  double total_ms, sampled_ms;
+  int sampled;
+};
+
+// Pixel rectangle and nearest depth of a triangle or of a mesh's bounding box.
+// Not valid for boxes reaching behind the camera.
+struct ScreenBounds {
+  bool valid;
+  int x_min, y_min, x_max, y_max;
+  Real min_depth;
+};
+
+// A clipped triangle in screen space, waiting in the tile bins
+struct RasterTriangle {
+  VertexOut v[3];
+  Matrix4r TBN_matrix;
+  int mesh;
+  ScreenBounds bounds;
 };
 
 class Pipeline {
@@ -26,12 +107,16 @@ class Pipeline {
   Pipeline(int width, int height);
   ~Pipeline();
 
-  void ClearBuffer(const Vector4d &color);
+  void ClearBuffer(const Vector4r &color);
   void SwapBuffer();
 
   void SwitchMode(RenderMode mode);
 
+  // redraws the parts of the shadow maps that moved since the last call
   void RenderShadowMap();
+  void InvalidateShadowMaps() { shadow_map_->Invalidate(); }
+  // debug export of the shadow maps on a background thread, see ShadowMap
+  void ExportShadowMaps(const std::string &pattern) { shadow_map_->ExportShadowMaps(pattern); }
   void Draw(RenderMode mode);
 
   void AddLight(Light *light) {
@@ -50,28 +135,64 @@ class Pipeline {
   void SetSkybox(Skybox *skybox) {
 	skybox_ = skybox;
   }
-  void SetProjectMatrix(Matrix4d *p) {
+  void SetProjectMatrix(Matrix4r *p) {
 	shader_->set_project_matrix(p);
 	project_matrix_ = p;
   }
 
-  static bool InTriangle(const Vector2d &p, const Vector3d &a, const Vector3d &b, const Vector3d &c,
-						 double &alpha, double &beta, double &gamma);
+  // levels the CPU does not support fall back to the best one it does
+  void set_simd_level(SimdLevel level) {
+	SimdLevel supported = DetectSimdLevel();
+	simd_level_ = level > supported ? supported : level;
+  }
+  SimdLevel simd_level() const { return simd_level_; }
+
+  // false clips every triangle against all 7 planes
+  void set_guard_band(bool guard_band) { guard_band_ = guard_band; }
+  bool guard_band() const { return guard_band_; }
+
+  // the back-end runs rasterization and fragment shading together, so its time
+  // is split between the two by the share of sampled shader calls
+  void set_stage_timing(bool stage_timing) { stage_timing_ = stage_timing; }
+  bool stage_timing() const { return stage_timing_; }
+  const StageTimes &stage_times() const { return stage_times_; }
+  void ResetStageTimes() { stage_times_ = StageTimes(); }
+
+  // Rasterizes the depth of every filled triangle before shading, so the shading
+  // pass runs the fragment shader once per visible pixel. Ignored in line mode.
+  void set_depth_prepass(bool depth_prepass) { depth_prepass_ = depth_prepass; }
+  bool depth_prepass() const { return depth_prepass_; }
+
+  // Skips triangles, and meshes within a tile, that lie behind the farthest depth
+  // of the blocks they overlap. Only filled triangles are tested, the image is
+  // the same either way.
+  void set_hi_z_culling(bool hi_z_culling) { hi_z_culling_ = hi_z_culling; }
+  bool hi_z_culling() const { return hi_z_culling_; }
+
+  // counters of the last Draw
+  const PipelineStatistics &statistics() const { return statistics_; }
 
   unsigned char *ColorBuffer() { return front_buffer_->color_buffer(); }
   Shader *shader() { return shader_; }
 
  private:
-  bool BackFaceCulling(const Vector4d &v1, const Vector4d &v2, const Vector4d &v3);
-  std::vector<VertexOut> HomogeneousClipping(const VertexOut &p1,
-											 const VertexOut &p2,
-											 const VertexOut &p3);
-  std::vector<VertexOut> ClipWithPlane(ClipPlane type,
-									   int &num_vertex,
-									   const std::vector<VertexOut> &vertices);
+  bool BackFaceCulling(const Vector4r &v1, const Vector4r &v2, const Vector4r &v3);
   void PerspectiveDivision(VertexOut &v);
-  void DrawLine(const VertexOut &p1, const VertexOut &p2);
-  void DrawTriangle(const VertexOut &p1, const VertexOut &p2, const VertexOut &p3);
+  ScreenBounds MeshScreenBounds(const Mesh *mesh, const Matrix4r &mvp) const;
+  void DrawTile(RenderMode mode, const Tile &tile, TileStats &stats);
+  // one pass over the triangles binned to tile
+  void DrawTilePass(RenderMode mode, const Tile &tile, DepthPass pass, TileStats &stats);
+  // whether the part of bounds inside tile is hidden according to the hi-z buffer
+  bool TileOccluded(const ScreenBounds &bounds, const Tile &tile);
+  void DrawLine(const VertexOut &p1, const VertexOut &p2,
+				const Uniform &uniform, const Tile &tile, TileStats &stats);
+  void DrawTriangle(const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+					const Uniform &uniform, const Tile &tile, DepthPass pass, TileStats &stats);
+  // Runs the fragment shader and writes pixel x y, or the G-buffer when deferred.
+  // The call is timed when it is a sample.
+  void ShadeFragment(int x, int y, const VertexOut &fragment, const Uniform &uniform, TileStats &stats);
+  // lighting pass of deferred shading over the covered pixels of tile
+  void LightTile(const Tile &tile);
   void DrawSkybox(RenderMode mode);
   void DrawSkyboxTriangle(const SkyBoxVertex &v1,
 						  const SkyBoxVertex &v2,
@@ -83,9 +204,27 @@ class Pipeline {
   Shader *shader_;
   ShadowMap *shadow_map_;
   FrameBuffer *front_buffer_, *back_buffer_;
-  Matrix4d viewport_matrix_, *view_matrix_, *project_matrix_;
+  GBuffer *gbuffer_;    // allocated by the first deferred Draw
+  HiZBuffer *hi_z_buffer_;
+  Matrix4r viewport_matrix_, *view_matrix_, *project_matrix_;
   std::vector<Mesh *> meshes_;
   Skybox *skybox_;
+  ThreadPool *thread_pool_;
+  TileGrid *tile_grid_;
+  SimdLevel simd_level_;
+  bool guard_band_;
+  bool stage_timing_;
+  bool depth_prepass_;
+  bool deferred_;    // mode of the current Draw
+  bool hi_z_culling_;
+  StageTimes stage_times_;
+  PipelineStatistics statistics_;
+  std::vector<TileStats> tile_stats_;
+  std::vector<VertexOut> vertex_cache_;    // post-transform vertices of the current mesh
+  std::vector<Vector4r> view_positions_;   // before perspective correction, for culling
+  std::vector<RasterTriangle> triangles_;
+  std::vector<ScreenBounds> mesh_bounds_;
+  std::vector<Matrix4r> model_normal_matrices_;    // one per mesh
 };
 
 #endif //SOFTRENDERER_INCLUDE_PIPELINE_H_
@@ -0,0 +1,59 @@
+#ifndef SOFTRENDERER_INCLUDE_PROFILER_H_
+#define SOFTRENDERER_INCLUDE_PROFILER_H_
+
+#include <cstdint>
+#include <string>
+
+// Scoped timing zones, compiled in with SOFTRENDERER_PROFILE. Without it the
+// PROFILE_ZONE macros expand to nothing and no code is generated.
+// SOFTRENDERER_PROFILE_FRAGMENTS additionally adds a zone to every fragment
+// shader call, which slows shading down several times.
+#ifdef SOFTRENDERER_PROFILE
+const bool kProfilingEnabled = true;
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// name must be a string literal or otherwise outlive the profile
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+const bool kProfilingEnabled = false;
+#define PROFILE_ZONE(name)
+#endif
+
+#if defined(SOFTRENDERER_PROFILE) && defined(SOFTRENDERER_PROFILE_FRAGMENTS)
+#define PROFILE_FRAGMENT_ZONE(name) PROFILE_ZONE(name)
+#else
+#define PROFILE_FRAGMENT_ZONE(name)
+#endif
+
+// Events per thread, older ones are overwritten
+const int kProfileRingSize = 1 << 16;
+
+// Collects zones into one ring buffer per thread. Recording takes no lock,
+// a thread only locks once to register its buffer.
+class Profiler {
+ public:
+  // nanoseconds since the first call in this process
+  static int64_t Now();
+  static void Record(const char *name, int64_t start, int64_t end);
+
+  // Writes the recorded zones of every thread as Chrome trace JSON, viewable in
+  // chrome://tracing or Perfetto. Call it while no zones are being recorded,
+  // for example between frames.
+  static bool WriteChromeTrace(const std::string &path);
+  // drops every recorded event
+  static void Clear();
+};
+
+class ProfileZone {
+ public:
+  explicit ProfileZone(const char *name) : name_(name), start_(Profiler::Now()) {}
+  ~ProfileZone() { Profiler::Record(name_, start_, Profiler::Now()); }
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+ private:
+  const char *name_;
+  int64_t start_;
+};
+
+#endif //SOFTRENDERER_INCLUDE_PROFILER_H_
@@ -0,0 +1,139 @@
+#ifndef SOFTRENDERER_INCLUDE_RASTER_SIMD_H_
+#define SOFTRENDERER_INCLUDE_RASTER_SIMD_H_
+
+#include "global_config.h"
+#include "rasterizer.h"
+#include "vertex.h"
+
+// What a rasterization pass does with the depth buffer
+enum class DepthPass {
+  kShade,       // less-equal test, write depth and shade the passing pixels
+  kDepthOnly,   // less-equal test and write depth, nothing is interpolated or shaded
+  kShadeEqual   // shade the pixels whose depth equals the buffer, as left by kDepthOnly
+};
+
+// best level supported by both this build and the running CPU
+SimdLevel DetectSimdLevel();
+
+// attribute values and depths at the three vertices of a triangle
+struct TriangleAttributes {
+  // interpolated attributes, in the order they are stored per lane
+  enum Attribute {
+	kWorldX, kWorldY, kWorldZ, kWorldW,
+	kViewX, kViewY, kViewZ, kViewW,
+	kNormalX, kNormalY, kNormalZ, kNormalW,
+	kTexU, kTexV,
+	kOneDivZ,
+	kNumAttributes
+  };
+
+  Real value[kNumAttributes][3];
+  Real z[3];
+
+  void Setup(int i, const VertexOut &p) {
+	value[kWorldX][i] = p.world_position.x;
+	value[kWorldY][i] = p.world_position.y;
+	value[kWorldZ][i] = p.world_position.z;
+	value[kWorldW][i] = p.world_position.w;
+	value[kViewX][i] = p.view_position.x;
+	value[kViewY][i] = p.view_position.y;
+	value[kViewZ][i] = p.view_position.z;
+	value[kViewW][i] = p.view_position.w;
+	value[kNormalX][i] = p.normal.x;
+	value[kNormalY][i] = p.normal.y;
+	value[kNormalZ][i] = p.normal.z;
+	value[kNormalW][i] = p.normal.w;
+	value[kTexU][i] = p.texcoord.x;
+	value[kTexV][i] = p.texcoord.y;
+	value[kOneDivZ][i] = p.one_div_z;
+	z[i] = p.pixel_position.z;
+  }
+
+  // copy one lane of the interpolated attributes into fragment
+  static void BuildFragment(const Real out[kNumAttributes][kRasterBlockSize], int lane,
+							VertexOut &fragment) {
+	fragment.world_position =
+		Vector4r(out[kWorldX][lane], out[kWorldY][lane], out[kWorldZ][lane], out[kWorldW][lane]);
+	fragment.view_position =
+		Vector4r(out[kViewX][lane], out[kViewY][lane], out[kViewZ][lane], out[kViewW][lane]);
+	fragment.normal =
+		Vector4r(out[kNormalX][lane], out[kNormalY][lane], out[kNormalZ][lane], out[kNormalW][lane]);
+	fragment.texcoord = Vector2r(out[kTexU][lane], out[kTexV][lane]);
+	fragment.one_div_z = out[kOneDivZ][lane];
+  }
+};
+
+// Evaluates the nx pixels of one block row. Fills depth and out with the
+// interpolated values of every lane and returns a bit per pixel that is covered
+// and passes the depth test against depth_row, covered gets a bit per covered pixel.
+typedef int (*RowKernel)(const TriangleSetup &setup, const TriangleAttributes &attr,
+						 int nx, Real w0_row, Real w1_row, Real w2_row,
+						 bool inside, const Real *depth_row, int &covered,
+						 Real depth[kRasterBlockSize],
+						 Real out[TriangleAttributes::kNumAttributes][kRasterBlockSize]);
+
+// A triangle set up for the row kernel of one instruction set and depth pass
+struct SimdTriangle {
+  TriangleSetup setup;
+  TriangleAttributes attr;
+  RowKernel kernel;
+};
+
+// false when the triangle covers no pixel of the rectangle, or when the build
+// has no SIMD kernels
+bool SetupTriangleSIMD(SimdLevel level, DepthPass pass,
+					   const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+					   int x_min, int y_min, int x_max, int y_max,
+					   SimdTriangle &triangle);
+
+// Rasterizes triangle p1 p2 p3 inside the inclusive rectangle, evaluating
+// coverage, depth and perspective-correct attributes for as many pixels of a
+// row as fit in a register: 4 doubles or 8 floats with AVX2, half that with SSE2.
+// Passing depths are written to depth_buffer, which holds width values per row,
+// before shade(x, y, fragment) runs for each pixel. kDepthOnly never calls shade
+// and kShadeEqual leaves the buffer untouched. Returns the number of covered
+// pixels, all of which were depth tested.
+// The fragments are bit-identical to the scalar path in Pipeline::DrawTriangle.
+template<typename FragmentFunc>
+inline int RasterizeTriangleSIMD(SimdLevel level, DepthPass pass,
+								 const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+								 int x_min, int y_min, int x_max, int y_max,
+								 Real *depth_buffer, int width,
+								 FragmentFunc shade) {
+  SimdTriangle triangle;
+  if (!SetupTriangleSIMD(level, pass, p1, p2, p3, x_min, y_min, x_max, y_max, triangle)) return 0;
+  const TriangleSetup &setup = triangle.setup;
+  int tested = 0;
+  Real depth[kRasterBlockSize], out[TriangleAttributes::kNumAttributes][kRasterBlockSize];
+  VertexOut fragment;
+
+  ForEachBlock(setup, [&](int bx, int by, int nx, int ny,
+						  Real w0_row, Real w1_row, Real w2_row, bool inside) {
+	for (int y = by; y < by + ny; y++) {
+	  Real *depth_row = depth_buffer + y * width + bx;
+	  int covered;
+	  int bits = triangle.kernel(setup, triangle.attr, nx, w0_row, w1_row, w2_row, inside, depth_row,
+								 covered, depth, out);
+	  for (; covered != 0; covered &= covered - 1)
+		tested++;
+	  if (pass == DepthPass::kDepthOnly) {
+		for (int k = 0; bits != 0; k++, bits >>= 1)
+		  if (bits & 1) depth_row[k] = depth[k];
+		bits = 0;
+	  }
+	  // fragment shader
+	  for (int k = 0; bits != 0; k++, bits >>= 1) {
+		if (!(bits & 1)) continue;
+		if (pass == DepthPass::kShade) depth_row[k] = depth[k];
+		TriangleAttributes::BuildFragment(out, k, fragment);
+		shade(bx + k, y, fragment);
+	  }
+	  w0_row += setup.e0.step_y;
+	  w1_row += setup.e1.step_y;
+	  w2_row += setup.e2.step_y;
+	}
+  });
+  return tested;
+}
+
+#endif //SOFTRENDERER_INCLUDE_RASTER_SIMD_H_
@@ -0,0 +1,126 @@
+#ifndef SOFTRENDERER_INCLUDE_RASTERIZER_H_
+#define SOFTRENDERER_INCLUDE_RASTERIZER_H_
+
+#include <algorithm>
+
+#include "vector.h"
+
+// Edge functions of a screen-space triangle. Each one is twice the signed area
+// spanned by an edge and the pixel, so it is linear in x and y and can be
+// stepped with one add per pixel instead of being evaluated from scratch.
+struct EdgeFunction {
+  Real w;            // value at the current pixel
+  Real step_x;       // change when x grows by one
+  Real step_y;       // change when y grows by one
+
+  // edge from p to q, evaluated at (x, y)
+  void Setup(const Vector3r &p, const Vector3r &q, Real x, Real y) {
+	step_x = p.y - q.y;
+	step_y = q.x - p.x;
+	w = (q.x - p.x) * (y - p.y) - (q.y - p.y) * (x - p.x);
+  }
+  // smallest and largest value over a block of nx * ny pixels whose
+  // top-left pixel has value w_origin, a linear function peaks at a corner
+  Real BlockMin(Real w_origin, int nx, int ny) const {
+	return w_origin + std::min<Real>(0, step_x * (nx - 1)) + std::min<Real>(0, step_y * (ny - 1));
+  }
+  Real BlockMax(Real w_origin, int nx, int ny) const {
+	return w_origin + std::max<Real>(0, step_x * (nx - 1)) + std::max<Real>(0, step_y * (ny - 1));
+  }
+};
+
+// Side length of the blocks the bounding box is split into before pixels are visited
+const int kRasterBlockSize = 8;
+
+// Edge setup of one triangle, shared by the scalar and the SIMD rasterizers
+struct TriangleSetup {
+  // e0 weights a, e1 weights b, e2 weights c
+  EdgeFunction e0, e1, e2;
+  Real one_div_area;
+  // k * step_x for every pixel of a block row. A pixel's edge value is the row
+  // value plus one of these, so all rasterizer paths agree bit for bit.
+  Real offset0[kRasterBlockSize], offset1[kRasterBlockSize], offset2[kRasterBlockSize];
+  int x_min, y_min, x_max, y_max;
+
+  // returns false when the triangle is degenerate or the rectangle is empty
+  bool Setup(const Vector3r &a, const Vector3r &b, const Vector3r &c,
+			 int x_min_, int y_min_, int x_max_, int y_max_) {
+	x_min = x_min_, y_min = y_min_, x_max = x_max_, y_max = y_max_;
+	if (x_min > x_max || y_min > y_max) return false;
+
+	e0.Setup(b, c, x_min, y_min);
+	e1.Setup(c, a, x_min, y_min);
+	e2.Setup(a, b, x_min, y_min);
+	Real area = e0.w + e1.w + e2.w;
+	if (area == 0.0) return false;
+	// flip clockwise triangles so that inside is always w >= 0
+	if (area < 0.0) {
+	  e0.w = -e0.w, e0.step_x = -e0.step_x, e0.step_y = -e0.step_y;
+	  e1.w = -e1.w, e1.step_x = -e1.step_x, e1.step_y = -e1.step_y;
+	  e2.w = -e2.w, e2.step_x = -e2.step_x, e2.step_y = -e2.step_y;
+	  area = -area;
+	}
+	one_div_area = 1.0 / area;
+
+	for (int k = 0; k < kRasterBlockSize; k++) {
+	  offset0[k] = k * e0.step_x;
+	  offset1[k] = k * e1.step_x;
+	  offset2[k] = k * e2.step_x;
+	}
+	return true;
+  }
+};
+
+// Walks the rectangle of setup in blocks and classifies each one: blocks
+// outside an edge are skipped, the rest are passed to
+// func(bx, by, nx, ny, w0, w1, w2, inside) where w* are the edge values at the
+// top-left pixel and inside means no pixel of the block needs a coverage test.
+template<typename BlockFunc>
+inline void ForEachBlock(const TriangleSetup &setup, BlockFunc func) {
+  const EdgeFunction &e0 = setup.e0, &e1 = setup.e1, &e2 = setup.e2;
+  for (int by = setup.y_min; by <= setup.y_max; by += kRasterBlockSize) {
+	int ny = std::min(kRasterBlockSize, setup.y_max - by + 1);
+	for (int bx = setup.x_min; bx <= setup.x_max; bx += kRasterBlockSize) {
+	  int nx = std::min(kRasterBlockSize, setup.x_max - bx + 1);
+	  Real w0 = e0.w + (bx - setup.x_min) * e0.step_x + (by - setup.y_min) * e0.step_y;
+	  Real w1 = e1.w + (bx - setup.x_min) * e1.step_x + (by - setup.y_min) * e1.step_y;
+	  Real w2 = e2.w + (bx - setup.x_min) * e2.step_x + (by - setup.y_min) * e2.step_y;
+	  if (e0.BlockMax(w0, nx, ny) < 0 || e1.BlockMax(w1, nx, ny) < 0
+		  || e2.BlockMax(w2, nx, ny) < 0)
+		continue;
+	  bool inside = e0.BlockMin(w0, nx, ny) >= 0 && e1.BlockMin(w1, nx, ny) >= 0
+		  && e2.BlockMin(w2, nx, ny) >= 0;
+	  func(bx, by, nx, ny, w0, w1, w2, inside);
+	}
+  }
+}
+
+// Calls func(x, y, alpha, beta, gamma) for every pixel in the inclusive
+// rectangle that lies inside triangle abc, pixels on an edge included.
+// The triangle may be wound either way, degenerate triangles cover nothing.
+template<typename PixelFunc>
+inline void RasterizeTriangle(const Vector3r &a, const Vector3r &b, const Vector3r &c,
+							  int x_min, int y_min, int x_max, int y_max,
+							  PixelFunc func) {
+  TriangleSetup setup;
+  if (!setup.Setup(a, b, c, x_min, y_min, x_max, y_max)) return;
+
+  Real one_div_area = setup.one_div_area;
+  ForEachBlock(setup, [&](int bx, int by, int nx, int ny,
+						  Real w0_row, Real w1_row, Real w2_row, bool inside) {
+	for (int y = by; y < by + ny; y++) {
+	  for (int k = 0; k < nx; k++) {
+		Real w0 = w0_row + setup.offset0[k];
+		Real w1 = w1_row + setup.offset1[k];
+		Real w2 = w2_row + setup.offset2[k];
+		if (inside || (w0 >= 0 && w1 >= 0 && w2 >= 0))
+		  func(bx + k, y, w0 * one_div_area, w1 * one_div_area, w2 * one_div_area);
+	  }
+	  w0_row += setup.e0.step_y;
+	  w1_row += setup.e1.step_y;
+	  w2_row += setup.e2.step_y;
+	}
+  });
+}
+
+#endif //SOFTRENDERER_INCLUDE_RASTERIZER_H_
@@ -11,7 +11,8 @@ class Scene {
   Scene() : camera_(nullptr), skybox_(nullptr) { lights_.resize(0); meshes_.resize(0); }
   ~Scene() = default;
 
-  void LoadScene();
+  // base_path is the scene directory holding scene0_config.txt
+  void LoadScene(const std::string &base_path = "../assets/scene0/");
   void UpdateScene(int frame);
   void UnLoadScene();
 
@@ -4,40 +4,54 @@
 #include "aabb.h"
 #include "light.h"
 
+// State read by the fragment shader that changes per mesh or per triangle.
+// It is passed in explicitly so that tiles can be shaded concurrently.
+struct Uniform {
+  const Matrix4r *model_normal_matrix;
+  const Matrix4r *TBN_matrix;
+  Texture *albedo_texture, *normal_texture;
+};
+
 class Shader {
  public:
   Shader() = default;
   virtual ~Shader() = default;
 
   virtual VertexOut VertexShader(const VertexIn &in);
-  virtual Vector4d FragmentShader(const VertexOut &in) = 0;
+  virtual Vector4r FragmentShader(const VertexOut &in, const Uniform &uniform) = 0;
+  // Deferred shading runs the fragment shader in two halves: the surface shader
+  // computes what the G-buffer stores, the lighting shader lights it once the
+  // nearest surface of every pixel is known. The defaults leave it unlit.
+  virtual void SurfaceShader(const VertexOut &in, const Uniform &uniform,
+							 Vector4r &normal, Vector4r &albedo);
+  virtual Vector4r LightingShader(const Vector4r &position, const Vector4r &normal,
+								  const Vector4r &albedo);
 
   virtual void PerspectiveCorrection(VertexOut &in);
 
-  void set_model_matrix(Matrix4d *model) { model_matrix_ = model; set_model_normal_matrix(); }
-  void set_view_matrix(Matrix4d *view) { view_matrix_ = view; }
-  void set_project_matrix(Matrix4d *project) { project_matrix_ = project; }
-  void set_viewport_matrix(Matrix4d *viewport) { viewport_matrix_ = viewport; }
-  void albedo_texture(Texture *texture) { albedo_texture_ = texture; }
-  void normal_texture(Texture *texture) { normal_texture_ = texture; }
-  void set_view_pos(Vector3d *view_pos) { view_pos_ = view_pos; }
+  void set_model_matrix(Matrix4r *model) { model_matrix_ = model; set_model_normal_matrix(); }
+  void set_view_matrix(Matrix4r *view) { view_matrix_ = view; }
+  void set_project_matrix(Matrix4r *project) { project_matrix_ = project; }
+  void set_viewport_matrix(Matrix4r *viewport) { viewport_matrix_ = viewport; }
+  void set_view_pos(Vector3r *view_pos) { view_pos_ = view_pos; }
 
   void AddLight(Light *light) { lights_.push_back(light); }
 
   void TBN_matrix(const VertexIn &a, const VertexIn &b, const VertexIn &c);
+  const Matrix4r &TBN_matrix() const { return TBN_matrix_; }
+  const Matrix4r &model_normal_matrix() const { return model_normal_matrix_; }
 
  protected:
   void set_model_normal_matrix();
 
  protected:
-  Matrix4d *model_matrix_;
-  Matrix4d *view_matrix_;
-  Matrix4d *project_matrix_;
-  Matrix4d *viewport_matrix_;
-  Matrix4d model_normal_matrix_;
-  Matrix4d TBN_matrix_;
-  Texture *albedo_texture_, *normal_texture_;
-  Vector3d *view_pos_;
+  Matrix4r *model_matrix_;
+  Matrix4r *view_matrix_;
+  Matrix4r *project_matrix_;
+  Matrix4r *viewport_matrix_;
+  Matrix4r model_normal_matrix_;
+  Matrix4r TBN_matrix_;
+  Vector3r *view_pos_;
   std::vector<Light*> lights_;
 };
 
@@ -46,7 +60,11 @@ class PhongShader : public Shader {
   PhongShader() = default;
   virtual ~PhongShader() = default;
 
-  virtual Vector4d FragmentShader(const VertexOut &in) override;
+  virtual Vector4r FragmentShader(const VertexOut &in, const Uniform &uniform) override;
+  virtual void SurfaceShader(const VertexOut &in, const Uniform &uniform,
+							 Vector4r &normal, Vector4r &albedo) override;
+  virtual Vector4r LightingShader(const Vector4r &position, const Vector4r &normal,
+								  const Vector4r &albedo) override;
 };
 
 class LineShader : public Shader {
@@ -54,7 +72,7 @@ class LineShader : public Shader {
   LineShader() = default;
   virtual ~LineShader() = default;
 
-  virtual Vector4d FragmentShader(const VertexOut &in) override;
+  virtual Vector4r FragmentShader(const VertexOut &in, const Uniform &uniform) override;
 };
 
 class PBRShader : public Shader {
@@ -62,7 +80,11 @@ class PBRShader : public Shader {
   PBRShader() = default;
   virtual ~PBRShader() = default;
 
-  virtual Vector4d FragmentShader(const VertexOut &in) override;
+  virtual Vector4r FragmentShader(const VertexOut &in, const Uniform &uniform) override;
+  virtual void SurfaceShader(const VertexOut &in, const Uniform &uniform,
+							 Vector4r &normal, Vector4r &albedo) override;
+  virtual Vector4r LightingShader(const Vector4r &position, const Vector4r &normal,
+								  const Vector4r &albedo) override;
 };
 
 #endif //SOFTRENDERER_INCLUDE_SHADER_H_
@@ -1,32 +1,126 @@
 #ifndef SOFTRENDERER_INCLUDE_SHADOW_MAP_H_
 #define SOFTRENDERER_INCLUDE_SHADOW_MAP_H_
 
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "aabb.h"
 #include "light.h"
 #include "mesh.h"
+#include "thread_pool.h"
+#include "tile_grid.h"
+
+// Vertices transformed by one thread pool job of the shadow pass
+const int kShadowVertexBatchSize = 1024;
+
+// A shadow casting triangle in the pixel space of a light's shadow map
+struct ShadowTriangle {
+  Vector3r a, b, c;
+  int x_min, y_min, x_max, y_max;    // bounding box clamped to the shadow map
+};
+
+// Pixels of the shadow map a mesh covers, empty when x_min > x_max
+struct ShadowRect {
+  int x_min, y_min, x_max, y_max;
+};
+
+// One mesh as one light sees it, kept until the mesh moves
+struct ShadowMeshPass {
+  ShadowMeshPass(int width, int height) : rect{0, 0, -1, -1}, tile_grid(width, height) {}
 
+  AABB view_bounds;                      // in the light's view from the origin, for the fit
+  ShadowRect rect;                       // pixels its triangles cover, empty when culled
+  std::vector<ShadowTriangle> triangles;
+  TileGrid tile_grid;                    // the triangles binned to the shadow map tiles
+};
+
+// Depth pass of one directional light and the state it was last rendered with
+struct ShadowPass {
+  ShadowPass(int width, int height) : tile_grid(width, height), rendered(false), shadow_generation(0) {
+	viewport_matrix.SetViewport(0, 0, width, height);
+  }
+
+  std::vector<ShadowMeshPass> mesh_passes;    // by mesh
+  std::vector<Vector3r> positions;       // shadow map position of every vertex
+  std::vector<char> dirty_tiles;         // tiles cleared and redrawn by the current update
+  TileGrid tile_grid;                    // tile layout, the bins are per mesh
+  Matrix4r viewport_matrix;              // light clip space to shadow map pixels
+
+  bool update, full;                     // what the current RenderShadowMap does with the light
+  bool rendered;
+  Vector4r light_dir;
+  Matrix4r shadow_matrix;
+  unsigned shadow_generation;            // of the light's shadow buffer
+};
+
+// Renders the depth maps of the directional lights. All lights share one
+// thread pool job per shadow map tile, so several lights fill the pool together.
+// Updates are incremental. When meshes move, each light refits its projection
+// from cached per-mesh bounds and measures only the moved meshes again. If the
+// fit, direction and buffer are unchanged, the light transforms and rebins only
+// the moved meshes and redraws the tiles under their old and new rectangles.
+// Lights that never saw a moved mesh and still do not see it are left alone.
 class ShadowMap {
  public:
-  ShadowMap() = default;
-  ~ShadowMap() = default;
+  explicit ShadowMap(ThreadPool *thread_pool) : thread_pool_(thread_pool), invalidated_(true) {}
+  ~ShadowMap();
 
   void AddLight(Light *light) { lights_.push_back(light); }
   void AddMesh(Mesh *mesh) { meshes_.push_back(mesh); }
 
-  void RenderShadowMap(const Matrix4d &viewport_matrix);
+  // each light renders at the size of its own shadow buffer
+  void RenderShadowMap();
+  // redraws every map on the next RenderShadowMap, for changes that are not
+  // tracked such as edited vertices
+  void Invalidate() { invalidated_ = true; }
+  // Writes every light's shadow map as a PNG, pattern holds one %d or %0Nd for
+  // the light index, see PathPattern. The maps are copied and then encoded on a
+  // background thread, so the next shadow pass does not wait. A previous export
+  // still running is waited for.
+  void ExportShadowMaps(const std::string &pattern);
 
  private:
-  void SetLights();
-  void SetShadowTexture(const VertexOut &p1,
-						const VertexOut &p2,
-						const VertexOut &p3,
-						Light *light);
-  VertexOut TransformVertex(const VertexIn &in, const Matrix4d &model_matrix, Light *light);
+  // a range of one mesh's vertices seen by one light
+  struct VertexBatch {
+	int light, mesh, begin, end;
+  };
+  struct BinJob {
+	int light, mesh;
+  };
+  struct TileJob {
+	int light, tile;
+  };
+  // copy of one shadow map for the export thread
+  struct ShadowImage {
+	std::string path;
+	int width, height;
+	std::vector<unsigned char> rgb;
+  };
+
+  // bins the triangles of one mesh in the light's view into its tiles
+  void BinMesh(ShadowPass *pass, int mesh);
+  // marks the tiles rect overlaps for redrawing
+  void MarkTiles(ShadowPass *pass, const ShadowRect &rect);
+  // clears the tile and draws the triangles every mesh binned to it
+  // 目前没有透视校正，因为只支持方向光阴影
+  void DrawTile(const ShadowPass &pass, int tile, ShadowBuffer *shadow_buffer);
+  Vector3r TransformVertex(const VertexIn &in, const Matrix4r &model_matrix, const Light *light,
+						   const Matrix4r &viewport_matrix);
 
  private:
+  ThreadPool *thread_pool_;    // owned by the pipeline
   std::vector<Light*> lights_;
   std::vector<Mesh*> meshes_;
-  char name_[17];
+  std::vector<ShadowPass*> passes_;     // by light, null for lights without a shadow map
+  std::vector<int> vertex_offsets_;     // first vertex of every mesh in ShadowPass::positions
+  std::vector<Matrix4r> mesh_matrices_;  // model matrices at the last render
+  std::vector<char> mesh_moved_;
+  bool invalidated_;
+  std::vector<VertexBatch> vertex_batches_;
+  std::vector<BinJob> bin_jobs_;
+  std::vector<TileJob> tile_jobs_;
+  std::thread export_thread_;
 };
 
 #endif //SOFTRENDERER_INCLUDE_SHADOW_MAP_H_
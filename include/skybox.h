@@ -14,8 +14,8 @@ struct SkyBoxVertex {
   SkyBoxVertex() = default;
   ~SkyBoxVertex() = default;
 
-  Vector4d pos;
-  Vector2d tex;
+  Vector4r pos;
+  Vector2r tex;
 };
 
 class Skybox {
@@ -24,12 +24,12 @@ class Skybox {
   ~Skybox() = default;
 
   void LoadSkybox(const std::string &path);
-  Vector4d Sample(const Vector2d &uv, Face face);
+  Vector4r Sample(const Vector2r &uv, Face face);
 
-  Vector4d TransformPos(const Matrix4d &viewport,
-						const Matrix4d &project,
-						const Matrix4d &view,
-						const Vector4d &pos);
+  Vector4r TransformPos(const Matrix4r &viewport,
+						const Matrix4r &project,
+						const Matrix4r &view,
+						const Vector4r &pos);
 
   const std::vector<SkyBoxVertex> &vertices() const { return vertices_; }
   const std::vector<int> &indices() const { return indices_; }
@@ -8,7 +8,7 @@ class Texture {
   Texture() : data_(nullptr) {}
   ~Texture();
 
-  Vector4d Sample(const Vector2d &tex);
+  Vector4r Sample(const Vector2r &tex);
   bool LoadImage(const char *path);
 
  private:
@@ -0,0 +1,41 @@
+#ifndef SOFTRENDERER_INCLUDE_THREAD_POOL_H_
+#define SOFTRENDERER_INCLUDE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run index-parallel jobs.
+// ParallelFor is not reentrant: do not call it from inside a job.
+class ThreadPool {
+ public:
+  // num_threads <= 0 uses every hardware thread
+  explicit ThreadPool(int num_threads = 0);
+  ~ThreadPool();
+
+  // call func(i) for every i in [0, count), the calling thread helps out
+  // and the function returns once all indices are done
+  void ParallelFor(int count, const std::function<void(int)> &func);
+
+  int num_threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+ private:
+  void WorkerLoop();
+  void RunJob();
+
+ private:
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_, done_cv_;
+  const std::function<void(int)> *job_;
+  int count_;
+  std::atomic<int> next_;
+  int active_;            // workers that have not finished the current job
+  unsigned generation_;   // bumped for every new job
+  bool stop_;
+};
+
+#endif //SOFTRENDERER_INCLUDE_THREAD_POOL_H_
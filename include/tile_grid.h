@@ -0,0 +1,36 @@
+#ifndef SOFTRENDERER_INCLUDE_TILE_GRID_H_
+#define SOFTRENDERER_INCLUDE_TILE_GRID_H_
+
+#include <vector>
+
+// A square block of the screen and the triangles touching it
+struct Tile {
+  int x_min, y_min, x_max, y_max;   // inclusive pixel bounds
+  std::vector<int> triangles;       // triangle ids in submission order
+};
+
+// Splits the screen into tiles and bins triangles by their pixel bounding box.
+// Tiles cover disjoint pixels, so they can be rasterized concurrently.
+class TileGrid {
+ public:
+  static const int kTileSize = 64;
+
+  TileGrid(int width, int height);
+  ~TileGrid() = default;
+
+  void Clear();
+  // add id to every tile overlapping the inclusive rectangle
+  void Bin(int id, int x_min, int y_min, int x_max, int y_max);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int num_tiles() const { return static_cast<int>(tiles_.size()); }
+  const Tile &tile(int i) const { return tiles_[i]; }
+
+ private:
+  int width_, height_;
+  int num_x_, num_y_;
+  std::vector<Tile> tiles_;
+};
+
+#endif //SOFTRENDERER_INCLUDE_TILE_GRID_H_
@@ -2,6 +2,9 @@
 #define SOFTRENDERER_INCLUDE_VECTOR_H_
 
 #include <cmath>
+#include <type_traits>
+
+#include "global_config.h"
 
 template <typename T>
 class Vector4;
@@ -83,9 +86,9 @@ class Vector3 {
   }
 
   float Norm() const { return std::sqrt(x * x + y * y + z * z); }
-  Vector3<double> Normalize() const {
+  Vector3 Normalize() const {
 	float norm = this->Norm();
-	return Vector3<double>(x / norm, y / norm, z / norm);
+	return Vector3(x / norm, y / norm, z / norm);
   }
 
   Vector3 operator-() { return Vector3(-x, -y, -z); }
@@ -94,14 +97,16 @@ class Vector3 {
   T x, y, z;
 };
 
-template <typename T>
-inline Vector3<T> operator*(T t, const Vector3<T> &rhs) {
-  return rhs * t;
+template <typename S, typename T,
+		  typename = typename std::enable_if<std::is_arithmetic<S>::value>::type>
+inline Vector3<T> operator*(S t, const Vector3<T> &rhs) {
+  return rhs * static_cast<T>(t);
 }
 
 using Vector3d = Vector3<double>;
 using Vector3f = Vector3<float>;
 using Vector3i = Vector3<int>;
+using Vector3r = Vector3<Real>;
 
 template <typename T>
 class Vector4 {
@@ -196,10 +201,10 @@ class Vector4 {
 	return this->x * rhs.x + this->y * rhs.y + this->z * rhs.z + this->w * rhs.w;
   }
 
-  double Norm() const { return std::sqrt(x * x + y * y + z * z + w * w); }
-  Vector4<double> Normalize() const {
+  T Norm() const { return std::sqrt(x * x + y * y + z * z + w * w); }
+  Vector4 Normalize() const {
 	float norm = this->Norm();
-	return Vector4<double>(x / norm, y / norm, z / norm, w / norm);
+	return Vector4(x / norm, y / norm, z / norm, w / norm);
   }
 
   Vector4 operator-() const { return Vector4(-x, -y, -z, -w); }
@@ -208,15 +213,16 @@ class Vector4 {
   T x, y, z, w;
 };
 
-template <typename T>
-inline Vector4<T> operator*(T t, const Vector4<T> &rhs) {
-  return rhs * t;
+template <typename S, typename T,
+		  typename = typename std::enable_if<std::is_arithmetic<S>::value>::type>
+inline Vector4<T> operator*(S t, const Vector4<T> &rhs) {
+  return rhs * static_cast<T>(t);
 }
 
 template <typename T>
 inline Vector4<T> Reflect(const Vector4<T> &in, const Vector4<T> &normal) {
   // in and normal are unit vectors
-  double cos_theta = in.Dot(normal);
+  T cos_theta = in.Dot(normal);
   Vector4<T> out1 = normal * cos_theta;
   Vector4<T> out2 = -in;
   return out2 + out1 * 2;
@@ -225,6 +231,7 @@ inline Vector4<T> Reflect(const Vector4<T> &in, const Vector4<T> &normal) {
 using Vector4d = Vector4<double>;
 using Vector4f = Vector4<float>;
 using Vector4i = Vector4<int>;
+using Vector4r = Vector4<Real>;
 
 template <typename T>
 class Vector2 {
@@ -280,9 +287,9 @@ class Vector2 {
   T Cross(const Vector2 &rhs) { return this->x * rhs.y - rhs.x * this->y; }
 
   float Norm() const { return std::sqrt(x * x + y * y); }
-  Vector2<float> Normalize() const {
+  Vector2 Normalize() const {
 	float norm = this->Norm();
-	return Vector2<float>(x / norm, y / norm);
+	return Vector2(x / norm, y / norm);
   }
 
   Vector2 operator-() { return Vector2(-x, -y); }
@@ -291,13 +298,15 @@ class Vector2 {
   T x, y;
 };
 
-template <typename T>
-inline Vector2<T> operator*(T t, const Vector2<T> &rhs) {
-  return rhs * t;
+template <typename S, typename T,
+		  typename = typename std::enable_if<std::is_arithmetic<S>::value>::type>
+inline Vector2<T> operator*(S t, const Vector2<T> &rhs) {
+  return rhs * static_cast<T>(t);
 }
 
 using Vector2d = Vector2<double>;
 using Vector2f = Vector2<float>;
 using Vector2i = Vector2<int>;
+using Vector2r = Vector2<Real>;
 
 #endif //SOFTRENDERER_INCLUDE_VECTOR_H_
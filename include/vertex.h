@@ -6,8 +6,8 @@
 // Input to the vertex shader
 struct VertexIn {
   VertexIn() = default;
-  VertexIn(const Vector4d &p, const Vector4d &c, const Vector4d &n,
-		   const Vector2d &t)
+  VertexIn(const Vector4r &p, const Vector4r &c, const Vector4r &n,
+		   const Vector2r &t)
 	  : local_position(p), color(c), normal(n), texcoord(t) {}
   VertexIn(const VertexIn &rhs)
 	  : local_position(rhs.local_position),
@@ -15,18 +15,18 @@ struct VertexIn {
 		normal(rhs.normal),
 		texcoord(rhs.texcoord) {}
 
-  Vector4d local_position;
-  Vector4d color;
-  Vector4d normal;
-  Vector2d texcoord;
+  Vector4r local_position;
+  Vector4r color;
+  Vector4r normal;
+  Vector2r texcoord;
 };
 
 // Output from the vertex shader
 struct VertexOut {
   VertexOut() = default;
-  VertexOut(const Vector4d &wp, const Vector4d &vp, const Vector4d &cp,
-			const Vector4d &pp, const Vector4d &c, const Vector4d &n,
-			const Vector2d &t, double odz)
+  VertexOut(const Vector4r &wp, const Vector4r &vp, const Vector4r &cp,
+			const Vector4r &pp, const Vector4r &c, const Vector4r &n,
+			const Vector2r &t, Real odz)
 	  : world_position(wp),
 		view_position(vp),
 		clip_position(cp),
@@ -45,7 +45,7 @@ struct VertexOut {
 		texcoord(rhs.texcoord),
 		one_div_z(rhs.one_div_z) {}
 
-  static VertexOut Lerp(const VertexOut &v1, const VertexOut &v2, double t) {
+  static VertexOut Lerp(const VertexOut &v1, const VertexOut &v2, Real t) {
 	VertexOut res;
 
 	res.world_position = v1.world_position + t * (v2.world_position - v1.world_position);
@@ -60,14 +60,14 @@ struct VertexOut {
 	return res;
   }
 
-  Vector4d world_position;
-  Vector4d view_position;
-  Vector4d clip_position;
-  Vector4d pixel_position;
-  Vector4d color;
-  Vector4d normal;
-  Vector2d texcoord;
-  double one_div_z;
+  Vector4r world_position;
+  Vector4r view_position;
+  Vector4r clip_position;
+  Vector4r pixel_position;
+  Vector4r color;
+  Vector4r normal;
+  Vector2r texcoord;
+  Real one_div_z;
 };
 
 #endif //SOFTRENDERER_INCLUDE_VERTEX_H_
@@ -41,7 +41,7 @@ class Window {
   double delta_time_;	// The amount of time that went from the previous frame to this frame
   int frame_;
   RenderMode mode_;
-  Matrix4d project_matrix_;
+  Matrix4r project_matrix_;
 };
 
 #endif //SOFTRENDERER_INCLUDE_WINDOW_H_
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "headless_renderer.h"
+#include "math_util.h"
+#include "profiler.h"
+
+// Mean, median and 99th percentile of a set of samples in milliseconds
+struct Summary {
+  double mean, median, p99, min, max;
+};
+
+static Summary Summarize(std::vector<double> samples) {
+  Summary summary = {0, 0, 0, 0, 0};
+  if (samples.empty()) return summary;
+  std::sort(samples.begin(), samples.end());
+  int n = samples.size();
+  for (int i = 0; i < n; i++) summary.mean += samples[i];
+  summary.mean /= n;
+  summary.median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+  // nearest rank
+  summary.p99 = samples[std::max(0, static_cast<int>(std::ceil(0.99 * n)) - 1)];
+  summary.min = samples.front();
+  summary.max = samples.back();
+  return summary;
+}
+
+static void WriteSummary(FILE *fp, const char *indent, const char *name, const Summary &summary,
+						 const char *end) {
+  fprintf(fp, "%s\"%s\": {\"mean\": %.4f, \"median\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f}%s\n",
+		  indent, name, summary.mean, summary.median, summary.p99, summary.min, summary.max, end);
+}
+
+// per-frame means of the counters summed over the measured frames
+static void WriteStatistics(FILE *fp, const PipelineStatistics &sum, int num_frames) {
+  double n = num_frames;
+  fprintf(fp, "  \"statistics\": {\n");
+  fprintf(fp, "    \"meshes_culled\": %.1f,\n", sum.meshes_culled / n);
+  fprintf(fp, "    \"vertices_shaded\": %.1f,\n", sum.vertices_shaded / n);
+  fprintf(fp, "    \"triangles_submitted\": %.1f,\n", sum.triangles_submitted / n);
+  fprintf(fp, "    \"backface_culled\": %.1f,\n", sum.backface_culled / n);
+  fprintf(fp, "    \"trivially_rejected\": %.1f,\n", sum.trivially_rejected / n);
+  fprintf(fp, "    \"triangles_clipped\": %.1f,\n", sum.triangles_clipped / n);
+  fprintf(fp, "    \"clip_triangles_generated\": %.1f,\n", sum.clip_triangles_generated / n);
+  fprintf(fp, "    \"triangles_rasterized\": %.1f,\n", sum.triangles_rasterized / n);
+  fprintf(fp, "    \"triangles_occluded\": %.1f,\n", sum.triangles_occluded / n);
+  fprintf(fp, "    \"pixels_tested\": %.1f,\n", sum.pixels_tested / n);
+  fprintf(fp, "    \"depth_passed\": %.1f,\n", sum.depth_passed / n);
+  fprintf(fp, "    \"depth_failed\": %.1f,\n", sum.depth_failed / n);
+  fprintf(fp, "    \"fragments_shaded\": %.1f,\n", sum.fragments_shaded / n);
+  fprintf(fp, "    \"pixels_covered\": %.1f,\n", sum.pixels_covered / n);
+  fprintf(fp, "    \"overdraw\": %.4f\n", sum.overdraw());
+  fprintf(fp, "  },\n");
+}
+
+// An orbit around the teapot of scene0 that closes in halfway, so both whole
+// and clipped views are measured
+static std::vector<CameraKey> DefaultCameraPath() {
+  const int kKeys = 17;
+  const Vector3r center(0.0, 0.0, -6.0);
+  std::vector<CameraKey> keys(kKeys);
+  for (int i = 0; i < kKeys; i++) {
+	Real angle = 2.0 * kPI * i / (kKeys - 1);
+	Real radius = 6.0 - 4.0 * sin(kPI * i / (kKeys - 1));
+	keys[i].eye = Vector3r(center.x + radius * sin(angle), 1.0, center.z + radius * cos(angle));
+	keys[i].target = center;
+  }
+  return keys;
+}
+
+static void PrintUsage(const char *program) {
+  printf("Usage: %s [options]\n"
+		 "  --width W, --height H   frame size (500x500)\n"
+		 "  --frames N              measured frames (200)\n"
+		 "  --warmup N              frames rendered before measuring (10)\n"
+		 "  --mode MODE             full, pbr, line or deferred (full)\n"
+		 "  --simd scalar|sse2|avx2 rasterizer instruction set (best supported)\n"
+		 "  --scene DIR             scene directory (../assets/scene0/)\n"
+		 "  --camera-path FILE      camera key frames, defaults to an orbit around the teapot\n"
+		 "  --static-shadows        render the shadow maps once instead of fully every frame\n"
+		 "  --depth-prepass         rasterize depth before shading\n"
+		 "  --no-hi-z               disable hierarchical z occlusion culling\n"
+		 "  --no-stage-timing       measure frame times only\n"
+		 "  --json FILE             result file (benchmark.json), - for stdout\n"
+		 "  --trace FILE            write the measured frames as Chrome trace JSON,\n"
+		 "                          needs a SOFTRENDERER_PROFILE build\n",
+		 program);
+}
+
+int main(int argc, char *argv[]) {
+  int width = 500, height = 500, num_frames = 200, num_warmup = 10;
+  RenderMode mode = RenderMode::kFull;
+  std::string mode_name = "full", simd_name, scene_path = "../assets/scene0/", camera_path;
+  std::string json_path = "benchmark.json", trace_path;
+  bool static_shadows = false, stage_timing = true, depth_prepass = false, hi_z = true;
+
+  for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--help" || arg == "-h") {
+	  PrintUsage(argv[0]);
+	  return 0;
+	} else if (arg == "--static-shadows") {
+	  static_shadows = true;
+	  continue;
+	} else if (arg == "--depth-prepass") {
+	  depth_prepass = true;
+	  continue;
+	} else if (arg == "--no-hi-z") {
+	  hi_z = false;
+	  continue;
+	} else if (arg == "--no-stage-timing") {
+	  stage_timing = false;
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  printf("Missing value for %s.\n", arg.c_str());
+	  return 1;
+	}
+	std::string value = argv[++i];
+	if (arg == "--width") width = atoi(value.c_str());
+	else if (arg == "--height") height = atoi(value.c_str());
+	else if (arg == "--frames") num_frames = atoi(value.c_str());
+	else if (arg == "--warmup") num_warmup = atoi(value.c_str());
+	else if (arg == "--simd") simd_name = value;
+	else if (arg == "--scene") scene_path = value + "/";
+	else if (arg == "--camera-path") camera_path = value;
+	else if (arg == "--json") json_path = value;
+	else if (arg == "--trace") trace_path = value;
+	else if (arg == "--mode") {
+	  mode_name = value;
+	  if (value == "full") mode = RenderMode::kFull;
+	  else if (value == "pbr") mode = RenderMode::kPBR;
+	  else if (value == "deferred") mode = RenderMode::kDeferred;
+	  else if (value == "line") mode = RenderMode::kLine;
+	  else {
+		printf("Unknown mode %s.\n", value.c_str());
+		return 1;
+	  }
+	} else {
+	  printf("Unknown option %s.\n", arg.c_str());
+	  PrintUsage(argv[0]);
+	  return 1;
+	}
+  }
+  if (width <= 0 || height <= 0 || num_frames <= 0 || num_warmup < 0) {
+	printf("Frame size and count must be positive.\n");
+	return 1;
+  }
+
+  HeadlessRenderer renderer(width, height);
+  Pipeline *pipeline = renderer.pipeline();
+  if (!simd_name.empty()) {
+	if (simd_name == "scalar") pipeline->set_simd_level(SimdLevel::kScalar);
+	else if (simd_name == "sse2") pipeline->set_simd_level(SimdLevel::kSSE2);
+	else if (simd_name == "avx2") pipeline->set_simd_level(SimdLevel::kAVX2);
+	else {
+	  printf("Unknown SIMD level %s.\n", simd_name.c_str());
+	  return 1;
+	}
+  }
+  pipeline->set_depth_prepass(depth_prepass);
+  pipeline->set_hi_z_culling(hi_z);
+  const char *simd_names[] = {"scalar", "sse2", "avx2"};
+  simd_name = simd_names[static_cast<int>(pipeline->simd_level())];
+
+  std::vector<CameraKey> keys;
+  if (camera_path.empty()) keys = DefaultCameraPath();
+  else if (!LoadCameraPath(camera_path, keys)) return 1;
+  renderer.set_camera_path(keys);
+  renderer.LoadScene(scene_path);
+  renderer.SwitchRenderMode(mode);
+
+  // the camera path spans the measured frames, warm-up frames repeat its start
+  for (int frame = 0; frame < num_warmup; frame++)
+	renderer.RenderFrame(0, num_frames);
+
+  std::vector<double> frame_ms(num_frames);
+  std::vector<double> clear_ms(num_frames), vertex_ms(num_frames), clip_ms(num_frames),
+	  raster_ms(num_frames), fragment_ms(num_frames), shadow_ms(num_frames);
+  PipelineStatistics statistics;
+  pipeline->set_stage_timing(stage_timing);
+  Profiler::Clear();
+  for (int frame = 0; frame < num_frames; frame++) {
+	pipeline->ResetStageTimes();
+	auto start = std::chrono::steady_clock::now();
+	// nothing in the scene moves, so without invalidating the update would be empty
+	if (!static_shadows) {
+	  pipeline->InvalidateShadowMaps();
+	  pipeline->RenderShadowMap();
+	}
+	renderer.RenderFrame(frame, num_frames);
+	frame_ms[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	statistics += pipeline->statistics();
+	const StageTimes &times = pipeline->stage_times();
+	clear_ms[frame] = times.clear;
+	vertex_ms[frame] = times.vertex;
+	clip_ms[frame] = times.clip;
+	raster_ms[frame] = times.raster;
+	fragment_ms[frame] = times.fragment;
+	shadow_ms[frame] = times.shadow;
+  }
+
+  if (!trace_path.empty()) {
+	if (!kProfilingEnabled) printf("Built without SOFTRENDERER_PROFILE, the trace is empty.\n");
+	Profiler::WriteChromeTrace(trace_path);
+  }
+
+  Summary frame = Summarize(frame_ms);
+  printf("%d frames at %dx%d, %s, %s, %s: mean %.2f ms, median %.2f ms, p99 %.2f ms\n",
+		 num_frames, width, height, mode_name.c_str(), simd_name.c_str(),
+		 sizeof(Real) == sizeof(float) ? "float" : "double", frame.mean, frame.median, frame.p99);
+  if (stage_timing) {
+	printf("stage means: clear %.2f, vertex %.2f, clip %.2f, raster %.2f, fragment %.2f, shadow %.2f ms\n",
+		   Summarize(clear_ms).mean, Summarize(vertex_ms).mean, Summarize(clip_ms).mean,
+		   Summarize(raster_ms).mean, Summarize(fragment_ms).mean, Summarize(shadow_ms).mean);
+  }
+  printf("per frame: %.0f triangles, %.0f rasterized, %.0f occluded, %.0f fragments shaded, "
+		 "%.0f depth failed, overdraw %.2f\n",
+		 statistics.triangles_submitted / static_cast<double>(num_frames),
+		 statistics.triangles_rasterized / static_cast<double>(num_frames),
+		 statistics.triangles_occluded / static_cast<double>(num_frames),
+		 statistics.fragments_shaded / static_cast<double>(num_frames),
+		 statistics.depth_failed / static_cast<double>(num_frames), statistics.overdraw());
+
+  FILE *fp = json_path == "-" ? stdout : fopen(json_path.c_str(), "w");
+  if (!fp) {
+	printf("Failed to open %s.\n", json_path.c_str());
+	return 1;
+  }
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"warmup\": %d,\n",
+		  width, height, num_frames, num_warmup);
+  fprintf(fp, "  \"mode\": \"%s\",\n  \"simd\": \"%s\",\n  \"real\": \"%s\",\n  \"threads\": %u,\n",
+		  mode_name.c_str(), simd_name.c_str(), sizeof(Real) == sizeof(float) ? "float" : "double",
+		  std::thread::hardware_concurrency());
+  fprintf(fp, "  \"static_shadows\": %s,\n", static_shadows ? "true" : "false");
+  fprintf(fp, "  \"depth_prepass\": %s,\n", depth_prepass ? "true" : "false");
+  fprintf(fp, "  \"hi_z\": %s,\n", hi_z ? "true" : "false");
+  WriteStatistics(fp, statistics, num_frames);
+  WriteSummary(fp, "  ", "frame_ms", frame, stage_timing ? "," : "");
+  if (stage_timing) {
+	fprintf(fp, "  \"stage_ms\": {\n");
+	WriteSummary(fp, "    ", "clear", Summarize(clear_ms), ",");
+	WriteSummary(fp, "    ", "vertex", Summarize(vertex_ms), ",");
+	WriteSummary(fp, "    ", "clip", Summarize(clip_ms), ",");
+	WriteSummary(fp, "    ", "raster", Summarize(raster_ms), ",");
+	WriteSummary(fp, "    ", "fragment", Summarize(fragment_ms), ",");
+	WriteSummary(fp, "    ", "shadow", Summarize(shadow_ms), "");
+	fprintf(fp, "  }\n");
+  }
+  fprintf(fp, "}\n");
+  if (fp != stdout) fclose(fp);
+  return 0;
+}
@@ -2,8 +2,8 @@
 
 #include "math_util.h"
 
-Camera::Camera(const Vector3d &eye, const Vector3d &dir, const Vector3d &up,
-			   double speed)
+Camera::Camera(const Vector3r &eye, const Vector3r &dir, const Vector3r &up,
+			   Real speed)
 	: eye_(eye),
 	  dir_(dir.Normalize()),
 	  up_(up.Normalize()),
@@ -13,16 +13,16 @@ Camera::Camera(const Vector3d &eye, const Vector3d &dir, const Vector3d &up,
   view_matrix_.SetView(eye_, dir_, up_);
 }
 
-void Camera::MoveForward(double delta_time) {
+void Camera::MoveForward(Real delta_time) {
   eye_ -= delta_time * speed_ * dir_;
 }
-void Camera::MoveBack(double delta_time) {
+void Camera::MoveBack(Real delta_time) {
   eye_ += delta_time * speed_ * dir_;
 }
-void Camera::MoveLeft(double delta_time) {
+void Camera::MoveLeft(Real delta_time) {
   eye_ -= delta_time * speed_ * (up_.Cross(dir_)).Normalize();
 }
-void Camera::MoveRight(double delta_time) {
+void Camera::MoveRight(Real delta_time) {
   eye_ += delta_time * speed_ * (up_.Cross(dir_)).Normalize();
 }
 
@@ -32,9 +32,17 @@ void Camera::Rotate(int offset_x, int offset_y) {
   pitch_ += offset_y * 0.25;
   if (pitch_ > 89.0) pitch_ = 89.0;
   if (pitch_ < -89.0) pitch_ = -89.0;
-  Vector3d dir;
+  Vector3r dir;
   dir.x = cos(Radian(pitch_)) * cos(Radian(yaw_));
   dir.y = sin(Radian(pitch_));
   dir.z = cos(Radian(pitch_)) * sin(Radian(yaw_));
   dir_ = dir.Normalize();
 }
+
+void Camera::LookAt(const Vector3r &eye, const Vector3r &target) {
+  eye_ = eye;
+  dir_ = (eye - target).Normalize();
+  // keep Rotate continuous from the new direction
+  pitch_ = Degree(asin(dir_.y));
+  yaw_ = Degree(atan2(dir_.z, dir_.x));
+}
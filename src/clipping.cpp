@@ -0,0 +1,100 @@
+#include "clipping.h"
+
+#include <algorithm>
+
+// Signed distance of a clip space position to a plane, positive inside.
+// An edge crosses the plane at t = d1 / (d1 - d2).
+static Real PlaneDistance(ClipPlane plane, const Vector4r &p) {
+  switch (plane) {
+	case ClipPlane::kWZero: return p.w;
+	case ClipPlane::kNear: return p.w + p.z;
+	case ClipPlane::kFar: return p.w - p.z;
+	case ClipPlane::kLeft: return p.w + p.x;
+	case ClipPlane::kRight: return p.w - p.x;
+	case ClipPlane::kTop: return p.w - p.y;
+	case ClipPlane::kBottom: return p.w + p.y;
+  }
+  return 0;
+}
+
+// bit i is set when p is outside ClipPlane(i)
+static int OutCode(const Vector4r &p) {
+  int code = 0;
+  for (int i = 0; i < kNumClipPlanes; i++) {
+	if (!(PlaneDistance(static_cast<ClipPlane>(i), p) > 0))
+	  code |= 1 << i;
+  }
+  return code;
+}
+
+// whether p stays within kGuardBand times the view volume in x and y
+static bool InsideGuardBand(const Vector4r &p) {
+  Real limit = kGuardBand * p.w;
+  return p.x >= -limit && p.x <= limit && p.y >= -limit && p.y <= limit;
+}
+
+bool BoxOutsideFrustum(const AABB &box, const Matrix4r &mvp, int planes) {
+  Vector4r min = box.min(), max = box.max();
+  int code = planes;
+  for (int i = 0; i < 8 && code; i++) {
+	Vector4r corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.0);
+	code &= OutCode(mvp * corner);
+  }
+  return code != 0;
+}
+
+ClipResult ClipTriangle(const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+						bool guard_band, ClipPolygon &polygon) {
+  int code1 = OutCode(p1.clip_position);
+  int code2 = OutCode(p2.clip_position);
+  int code3 = OutCode(p3.clip_position);
+  polygon.size = 0;
+  // trivial reject, all vertices outside the same plane
+  if (code1 & code2 & code3) return ClipResult::kRejected;
+
+  polygon.v[0] = p1;
+  polygon.v[1] = p2;
+  polygon.v[2] = p3;
+  polygon.size = 3;
+  int code = code1 | code2 | code3;
+  // inside the guard band the rasterizer clamps to the screen, so only the planes
+  // that keep w and depth valid need geometric clipping
+  if (guard_band && InsideGuardBand(p1.clip_position) && InsideGuardBand(p2.clip_position)
+	  && InsideGuardBand(p3.clip_position))
+	code &= kDepthClipPlanes;
+  // trivial accept
+  if (code == 0) return ClipResult::kAccepted;
+
+  // only the planes some vertex is outside of can change the polygon
+  ClipPolygon temp;
+  ClipPolygon *in = &polygon, *out = &temp;
+  for (int i = 0; i < kNumClipPlanes && in->size > 0; i++) {
+	if (code & (1 << i)) {
+	  ClipWithPlane(static_cast<ClipPlane>(i), *in, *out);
+	  std::swap(in, out);
+	}
+  }
+  if (in != &polygon) polygon = *in;
+  return ClipResult::kClipped;
+}
+
+void ClipWithPlane(ClipPlane plane, const ClipPolygon &in, ClipPolygon &out) {
+  out.size = 0;
+  if (in.size == 0) return;
+
+  Real first_d = 0, prev_d = 0;
+  for (int i = 0; i < in.size && out.size + 2 <= kMaxClipVertices; i++) {
+	Real d = PlaneDistance(plane, in.v[i].clip_position);
+	if (i == 0) first_d = d;
+	// intersect with the plane
+	if (i > 0 && (prev_d > 0) != (d > 0))
+	  out.v[out.size++] = VertexOut::Lerp(in.v[i - 1], in.v[i], prev_d / (prev_d - d));
+	// current point is in
+	if (d > 0)
+	  out.v[out.size++] = in.v[i];
+	prev_d = d;
+  }
+  // handle the last and the first
+  if ((prev_d > 0) != (first_d > 0) && out.size < kMaxClipVertices)
+	out.v[out.size++] = VertexOut::Lerp(in.v[in.size - 1], in.v[0], prev_d / (prev_d - first_d));
+}
@@ -1,12 +1,18 @@
 #include "frame_buffer.h"
 
+#include <algorithm>
+
+#include "math_util.h"
+#include "profiler.h"
+
 FrameBuffer::FrameBuffer(int width, int height)
 	: width_(width), height_(height), capacity_(4 * width * height) {
   color_buffer_.resize(capacity_);
   depth_buffer_.resize(width * height);
 }
 
-void FrameBuffer::ClearBuffer(const Vector4d &color) {
+void FrameBuffer::ClearBuffer(const Vector4r &color) {
+  PROFILE_ZONE("FrameBuffer::ClearBuffer");
   for (int i = 0; i < capacity_; i += 4) {
 	color_buffer_[i] = static_cast<unsigned char>(255 * color.x);
 	color_buffer_[i + 1] = static_cast<unsigned char>(255 * color.y);
@@ -20,7 +26,7 @@ void FrameBuffer::ClearBuffer(const Vector4d &color) {
   }
 }
 
-void FrameBuffer::DrawPixel(int x, int y, const Vector4d &color) {
+void FrameBuffer::DrawPixel(int x, int y, const Vector4r &color) {
   // points outside the frustum will be discarded
   if (x < 0 || x >= width_ || y < 0 || y >= height_)
 	return;
@@ -31,40 +37,75 @@ void FrameBuffer::DrawPixel(int x, int y, const Vector4d &color) {
   color_buffer_[index + 3] = static_cast<unsigned char>(color.w);
 }
 
-double FrameBuffer::GetDepth(int x, int y) {
+Real FrameBuffer::GetDepth(int x, int y) {
   if (x < 0 || x >= width_ || y < 0 || y >= height_)
 	return 1.0;
   return depth_buffer_[y * width_ + x];
 }
 
-void FrameBuffer::SetDepth(int x, int y, double depth) {
+void FrameBuffer::SetDepth(int x, int y, Real depth) {
   if (x < 0 || x >= width_ || y < 0 || y >= height_)
 	return;
   depth_buffer_[y * width_ + x] = depth;
 }
 
-ShadowBuffer::ShadowBuffer(int width, int height)
-	: width_(width), height_(height), capacity_(width * height) {
-  shadow_buffer_.resize(capacity_);
-  shadow_texture_.resize(3 * capacity_);
+GBuffer::GBuffer(int width, int height) : width_(width), height_(height) {
+  position_.resize(width * height);
+  normal_.resize(width * height);
+  albedo_.resize(4 * width * height);
+}
+
+ShadowBuffer::ShadowBuffer(int width, int height, ShadowFormat format)
+	: width_(width), height_(height), capacity_(width * height), format_(format) {
+  if (format_ == ShadowFormat::kDepth16)
+	depth16_.resize(capacity_);
+  else
+	depth32_.resize(capacity_);
 }
 
 void ShadowBuffer::ClearBuffer() {
-  for (int y = 0; y < height_; y++) {
-	for (int x = 0; x < width_; x++) {
-	  shadow_buffer_[y * width_ + x] = 0.0;
-	}
+  if (format_ == ShadowFormat::kDepth16)
+	std::fill(depth16_.begin(), depth16_.end(), 0);
+  else
+	std::fill(depth32_.begin(), depth32_.end(), 0.0f);
+}
+
+void ShadowBuffer::ClearRect(int x_min, int y_min, int x_max, int y_max) {
+  for (int y = y_min; y <= y_max; y++) {
+	int row = y * width_;
+	if (format_ == ShadowFormat::kDepth16)
+	  std::fill(depth16_.begin() + row + x_min, depth16_.begin() + row + x_max + 1, 0);
+	else
+	  std::fill(depth32_.begin() + row + x_min, depth32_.begin() + row + x_max + 1, 0.0f);
   }
 }
 
-double ShadowBuffer::GetDepth(int x, int y) {
+Real ShadowBuffer::GetDepth(int x, int y) {
   if (x < 0 || x >= width_ || y < 0 || y >= height_)
 	return 0.0;
-  return shadow_buffer_[y * width_ + x];
+  if (format_ == ShadowFormat::kDepth16)
+	return depth16_[y * width_ + x] * static_cast<Real>(1.0 / 65535.0);
+  return depth32_[y * width_ + x];
 }
 
-void ShadowBuffer::SetDepth(int x, int y, double depth) {
+void ShadowBuffer::SetDepth(int x, int y, Real depth) {
   if (x < 0 || x >= width_ || y < 0 || y >= height_)
 	return;
-  shadow_buffer_[y * width_ + x] = depth;
+  if (format_ == ShadowFormat::kDepth16) {
+	Clamp(depth, 0.0, 1.0);
+	depth16_[y * width_ + x] = static_cast<uint16_t>(depth * 65535.0 + 0.5);
+  } else {
+	depth32_[y * width_ + x] = static_cast<float>(depth);
+  }
+}
+
+unsigned char *ShadowBuffer::shadow_texture() {
+  shadow_texture_.resize(3 * capacity_);
+  for (int i = 0; i < capacity_; i++) {
+	unsigned char grey = static_cast<unsigned char>(GetDepth(i % width_, i / width_) * 255.0);
+	shadow_texture_[3 * i] = grey;
+	shadow_texture_[3 * i + 1] = grey;
+	shadow_texture_[3 * i + 2] = grey;
+  }
+  return shadow_texture_.data();
 }
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "headless_renderer.h"
+#include "path_pattern.h"
+#include "profiler.h"
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+		  "Usage: %s [options]\n"
+		  "  --width W, --height H   frame size (500x500)\n"
+		  "  --frames N              number of frames to render (1)\n"
+		  "  --mode MODE             full, pbr, line or deferred (full)\n"
+		  "  --scene DIR             scene directory (../assets/scene0/)\n"
+		  "  --camera-path FILE      camera key frames, one \"eye target\" per line\n"
+		  "  --format png|ppm|raw    image format, defaults to the output extension\n"
+		  "  --trace FILE            write the profile zones as Chrome trace JSON,\n"
+		  "                          needs a SOFTRENDERER_PROFILE build\n"
+		  "  --depth-prepass         rasterize depth before shading\n"
+		  "  --no-hi-z               disable hierarchical z occlusion culling\n"
+		  "  --stats                 print the pipeline statistics of every frame\n"
+		  "  --shadow-maps PATTERN   write the shadow maps as PNG, one %%d or %%0Nd\n"
+		  "                          is the light index\n"
+		  "  --output PATH           frame_%%04d.png by default. A path with one %%d or %%0Nd\n"
+		  "                          writes one file per frame, %%%% is a percent sign.\n"
+		  "                          Otherwise all frames go to one file, - writes them to stdout\n",
+		  program);
+}
+
+static bool ParseFormat(const std::string &name, ImageFormat &format) {
+  if (name == "png") format = ImageFormat::kPNG;
+  else if (name == "ppm") format = ImageFormat::kPPM;
+  else if (name == "raw" || name == "rgba") format = ImageFormat::kRaw;
+  else return false;
+  return true;
+}
+
+static void PrintStatistics(int frame, const PipelineStatistics &statistics) {
+  fprintf(stderr,
+		  "frame %d: %lld meshes culled, %lld vertices, %lld triangles, %lld back-face culled, %lld rejected, "
+		  "%lld clipped into %lld, %lld rasterized, %lld occluded in tiles\n"
+		  "  %lld pixels tested, %lld depth passed, %lld failed, %lld fragments shaded, "
+		  "%lld pixels covered, overdraw %.2f\n",
+		  frame, (long long)statistics.meshes_culled, (long long)statistics.vertices_shaded, (long long)statistics.triangles_submitted,
+		  (long long)statistics.backface_culled, (long long)statistics.trivially_rejected,
+		  (long long)statistics.triangles_clipped, (long long)statistics.clip_triangles_generated,
+		  (long long)statistics.triangles_rasterized, (long long)statistics.triangles_occluded,
+		  (long long)statistics.pixels_tested,
+		  (long long)statistics.depth_passed, (long long)statistics.depth_failed,
+		  (long long)statistics.fragments_shaded, (long long)statistics.pixels_covered,
+		  statistics.overdraw());
+}
+
+// stdout carries the frames, so everything printed while loading goes to stderr
+static FILE *TakeStdout() {
+  fflush(stdout);
+#ifdef _WIN32
+  int fd = _dup(_fileno(stdout));
+  _dup2(_fileno(stderr), _fileno(stdout));
+  _setmode(fd, _O_BINARY);
+  return _fdopen(fd, "wb");
+#else
+  int fd = dup(fileno(stdout));
+  dup2(fileno(stderr), fileno(stdout));
+  return fdopen(fd, "wb");
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  int width = 500, height = 500, num_frames = 1;
+  RenderMode mode = RenderMode::kFull;
+  std::string scene_path = "../assets/scene0/", camera_path, format_name, output = "frame_%04d.png";
+  std::string trace_path, shadow_map_pattern;
+  bool print_statistics = false, depth_prepass = false, hi_z = true;
+
+  for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--help" || arg == "-h") {
+	  PrintUsage(argv[0]);
+	  return 0;
+	} else if (arg == "--depth-prepass") {
+	  depth_prepass = true;
+	  continue;
+	} else if (arg == "--no-hi-z") {
+	  hi_z = false;
+	  continue;
+	} else if (arg == "--stats") {
+	  print_statistics = true;
+	  continue;
+	}
+	if (i + 1 >= argc) {
+	  fprintf(stderr, "Missing value for %s.\n", arg.c_str());
+	  PrintUsage(argv[0]);
+	  return 1;
+	}
+	std::string value = argv[++i];
+	if (arg == "--width") width = atoi(value.c_str());
+	else if (arg == "--height") height = atoi(value.c_str());
+	else if (arg == "--frames") num_frames = atoi(value.c_str());
+	else if (arg == "--scene") scene_path = value + "/";
+	else if (arg == "--camera-path") camera_path = value;
+	else if (arg == "--format") format_name = value;
+	else if (arg == "--trace") trace_path = value;
+	else if (arg == "--shadow-maps") shadow_map_pattern = value;
+	else if (arg == "--output" || arg == "-o") output = value;
+	else if (arg == "--mode") {
+	  if (value == "full") mode = RenderMode::kFull;
+	  else if (value == "pbr") mode = RenderMode::kPBR;
+	  else if (value == "deferred") mode = RenderMode::kDeferred;
+	  else if (value == "line") mode = RenderMode::kLine;
+	  else {
+		fprintf(stderr, "Unknown mode %s.\n", value.c_str());
+		return 1;
+	  }
+	} else {
+	  fprintf(stderr, "Unknown option %s.\n", arg.c_str());
+	  PrintUsage(argv[0]);
+	  return 1;
+	}
+  }
+  if (width <= 0 || height <= 0 || num_frames <= 0) {
+	fprintf(stderr, "Frame size and count must be positive.\n");
+	return 1;
+  }
+
+  if (format_name.empty()) {
+	std::size_t dot = output.rfind('.');
+	format_name = dot == std::string::npos ? "raw" : output.substr(dot + 1);
+  }
+  ImageFormat format;
+  if (!ParseFormat(format_name, format)) {
+	fprintf(stderr, "Unknown image format %s.\n", format_name.c_str());
+	return 1;
+  }
+
+  // the frame number is put into the path by PathPattern, never by printf
+  bool per_frame_files = output.find('%') != std::string::npos;
+  PathPattern output_pattern;
+  if (per_frame_files && !output_pattern.Parse(output)) {
+	fprintf(stderr, "Invalid output pattern %s.\n", output.c_str());
+	PrintUsage(argv[0]);
+	return 1;
+  }
+  PathPattern shadow_map_path;
+  if (!shadow_map_pattern.empty() && !shadow_map_path.Parse(shadow_map_pattern)) {
+	fprintf(stderr, "Invalid shadow map pattern %s.\n", shadow_map_pattern.c_str());
+	PrintUsage(argv[0]);
+	return 1;
+  }
+
+  FILE *stream = nullptr;
+  if (output == "-") {
+	stream = TakeStdout();
+  } else if (!per_frame_files) {
+	stream = fopen(output.c_str(), "wb");
+	if (!stream) {
+	  fprintf(stderr, "Failed to open %s.\n", output.c_str());
+	  return 1;
+	}
+  }
+
+  HeadlessRenderer renderer(width, height);
+  if (!camera_path.empty()) {
+	std::vector<CameraKey> keys;
+	if (!LoadCameraPath(camera_path, keys)) return 1;
+	renderer.set_camera_path(keys);
+  }
+  renderer.LoadScene(scene_path);
+  renderer.SwitchRenderMode(mode);
+  renderer.pipeline()->set_depth_prepass(depth_prepass);
+  renderer.pipeline()->set_hi_z_culling(hi_z);
+  if (!shadow_map_pattern.empty()) renderer.pipeline()->ExportShadowMaps(shadow_map_pattern);
+
+  double render_ms = 0.0;
+  for (int frame = 0; frame < num_frames; frame++) {
+	auto start = std::chrono::steady_clock::now();
+	unsigned char *color_buffer = renderer.RenderFrame(frame, num_frames);
+	render_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (print_statistics) PrintStatistics(frame, renderer.pipeline()->statistics());
+
+	FILE *frame_stream = stream;
+	if (per_frame_files) {
+	  std::string name = output_pattern.Format(frame);
+	  frame_stream = fopen(name.c_str(), "wb");
+	  if (!frame_stream) {
+		fprintf(stderr, "Failed to open %s.\n", name.c_str());
+		return 1;
+	  }
+	}
+	bool written = WriteImage(frame_stream, format, color_buffer, width, height);
+	if (per_frame_files) fclose(frame_stream);
+	if (!written) {
+	  fprintf(stderr, "Failed to write frame %d.\n", frame);
+	  return 1;
+	}
+  }
+  if (stream) fclose(stream);
+  if (!trace_path.empty()) {
+	if (!kProfilingEnabled) fprintf(stderr, "Built without SOFTRENDERER_PROFILE, the trace is empty.\n");
+	if (!Profiler::WriteChromeTrace(trace_path)) return 1;
+  }
+
+  fprintf(stderr, "Rendered %d frames at %dx%d in %.1f ms (%.2f ms/frame)\n",
+		  num_frames, width, height, render_ms, render_ms / num_frames);
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include "headless_renderer.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "profiler.h"
+#include "stb_image_write.h"
+
+bool LoadCameraPath(const std::string &path, std::vector<CameraKey> &keys) {
+  std::ifstream ifs(path);
+  if (ifs.fail()) {
+	printf("Failed to read camera path %s.\n", path.c_str());
+	return false;
+  }
+  std::string line;
+  for (int line_number = 1; std::getline(ifs, line); line_number++) {
+	std::istringstream iss(line);
+	std::string first;
+	if (!(iss >> first) || first[0] == '#') continue;
+	iss.str(line);
+	iss.clear();
+	CameraKey key;
+	if (!(iss >> key.eye.x >> key.eye.y >> key.eye.z >> key.target.x >> key.target.y >> key.target.z)) {
+	  printf("Camera path %s line %d is not \"eye_x eye_y eye_z target_x target_y target_z\".\n",
+			 path.c_str(), line_number);
+	  return false;
+	}
+	keys.push_back(key);
+  }
+  return true;
+}
+
+static void WriteToStream(void *context, void *data, int size) {
+  fwrite(data, 1, size, static_cast<FILE *>(context));
+}
+
+bool WriteImage(FILE *stream, ImageFormat format, const unsigned char *rgba, int width, int height) {
+  PROFILE_ZONE("WriteImage");
+  switch (format) {
+	case ImageFormat::kPNG:
+	  if (!stbi_write_png_to_func(WriteToStream, stream, width, height, 4, rgba, 4 * width))
+		return false;
+	  break;
+	case ImageFormat::kPPM: {
+	  fprintf(stream, "P6\n%d %d\n255\n", width, height);
+	  std::vector<unsigned char> rgb(3 * width);
+	  for (int y = 0; y < height; y++) {
+		const unsigned char *row = rgba + 4 * width * y;
+		for (int x = 0; x < width; x++) {
+		  rgb[3 * x] = row[4 * x];
+		  rgb[3 * x + 1] = row[4 * x + 1];
+		  rgb[3 * x + 2] = row[4 * x + 2];
+		}
+		fwrite(rgb.data(), 1, rgb.size(), stream);
+	  }
+	  break;
+	}
+	case ImageFormat::kRaw:
+	  fwrite(rgba, 1, 4 * width * height, stream);
+	  break;
+  }
+  return !ferror(stream);
+}
+
+HeadlessRenderer::HeadlessRenderer(int width, int height)
+	: width_(width),
+	  height_(height),
+	  mode_(RenderMode::kFull) {
+  project_matrix_.SetPerspective(60.0, static_cast<double>(width) / height, 1.0, 30.0);
+  pipeline_ = new Pipeline(width, height);
+  scene_ = new Scene();
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+  if (pipeline_)
+	delete pipeline_;
+  pipeline_ = nullptr;
+  if (scene_) {
+	scene_->UnLoadScene();
+	delete scene_;
+  }
+  scene_ = nullptr;
+}
+
+void HeadlessRenderer::LoadScene(const std::string &base_path) {
+  scene_->LoadScene(base_path);
+  pipeline_->SetCamera(scene_->camera());
+  SetLights();
+  SetMeshes();
+  pipeline_->SetSkybox(scene_->skybox());
+  pipeline_->SetProjectMatrix(&project_matrix_);
+  pipeline_->RenderShadowMap();
+}
+
+void HeadlessRenderer::SwitchRenderMode(RenderMode mode) {
+  if (mode == mode_) return;
+  mode_ = mode;
+  pipeline_->SwitchMode(mode_);
+  pipeline_->SetCamera(scene_->camera());
+  std::vector<Light*> &lights = scene_->lights();
+  for (int i = 0; i < lights.size(); i++)
+	pipeline_->shader()->AddLight(lights[i]);
+}
+
+unsigned char *HeadlessRenderer::RenderFrame(int frame, int num_frames) {
+  PROFILE_ZONE("Frame");
+  SetCamera(frame, num_frames);
+  pipeline_->RenderShadowMap();
+  pipeline_->ClearBuffer(Vector4r(0, 0, 0, 1.0));
+  pipeline_->Draw(mode_);
+  pipeline_->SwapBuffer();
+  return pipeline_->ColorBuffer();
+}
+
+void HeadlessRenderer::SetCamera(int frame, int num_frames) {
+  Camera *camera = scene_->camera();
+  if (!camera_path_.empty()) {
+	// piecewise linear between the key frames
+	Real t = num_frames > 1 ? static_cast<Real>(frame) * (camera_path_.size() - 1) / (num_frames - 1) : 0;
+	int key = std::min(static_cast<int>(t), static_cast<int>(camera_path_.size()) - 1);
+	int next = std::min(key + 1, static_cast<int>(camera_path_.size()) - 1);
+	Real s = t - key;
+	CameraKey a = camera_path_[key], b = camera_path_[next];
+	camera->LookAt(a.eye + s * (b.eye - a.eye), a.target + s * (b.target - a.target));
+  }
+  camera->UpdateView();
+  pipeline_->SetCamera(camera);
+}
+
+void HeadlessRenderer::SetLights() {
+  std::vector<Light*> &lights = scene_->lights();
+  for (int i = 0; i < lights.size(); i++) {
+	int shadow_width = lights[i]->shadow_width() > 0 ? lights[i]->shadow_width() : width_;
+	int shadow_height = lights[i]->shadow_height() > 0 ? lights[i]->shadow_height() : height_;
+	lights[i]->shadow_buffer(shadow_width, shadow_height);
+	lights[i]->shadow_buffer()->ClearBuffer();
+	pipeline_->AddLight(lights[i]);
+  }
+}
+
+void HeadlessRenderer::SetMeshes() {
+  std::vector<Mesh*> &meshes = scene_->meshes();
+  for (int i = 0; i < meshes.size(); i++)
+	pipeline_->AddMesh(meshes[i]);
+}
@@ -0,0 +1,61 @@
+#include "hi_z_buffer.h"
+
+#include <algorithm>
+
+HiZBuffer::HiZBuffer(int width, int height)
+	: width_(width),
+	  height_(height),
+	  num_x_((width + kBlockSize - 1) / kBlockSize),
+	  num_y_((height + kBlockSize - 1) / kBlockSize) {
+  min_depth_.assign(num_x_ * num_y_, 1.0);
+  max_depth_.assign(num_x_ * num_y_, 1.0);
+  dirty_.assign(num_x_ * num_y_, 0);
+}
+
+void HiZBuffer::Rescan(const Real *depth_buffer, int bx, int by) {
+  int x_begin = bx * kBlockSize, x_end = std::min(x_begin + kBlockSize, width_);
+  int y_begin = by * kBlockSize, y_end = std::min(y_begin + kBlockSize, height_);
+  Real min_depth = depth_buffer[y_begin * width_ + x_begin], max_depth = min_depth;
+  for (int y = y_begin; y < y_end; y++) {
+	const Real *row = depth_buffer + y * width_;
+	for (int x = x_begin; x < x_end; x++) {
+	  min_depth = std::min(min_depth, row[x]);
+	  max_depth = std::max(max_depth, row[x]);
+	}
+  }
+  int index = by * num_x_ + bx;
+  min_depth_[index] = min_depth;
+  max_depth_[index] = max_depth;
+  dirty_[index] = 0;
+}
+
+void HiZBuffer::Reset(const Real *depth_buffer, int x_min, int y_min, int x_max, int y_max) {
+  for (int by = y_min / kBlockSize; by <= y_max / kBlockSize; by++)
+	for (int bx = x_min / kBlockSize; bx <= x_max / kBlockSize; bx++)
+	  Rescan(depth_buffer, bx, by);
+}
+
+void HiZBuffer::Write(Real min_depth, int x_min, int y_min, int x_max, int y_max) {
+  for (int by = y_min / kBlockSize; by <= y_max / kBlockSize; by++) {
+	for (int bx = x_min / kBlockSize; bx <= x_max / kBlockSize; bx++) {
+	  int index = by * num_x_ + bx;
+	  min_depth_[index] = std::min(min_depth_[index], min_depth);
+	  dirty_[index] = 1;
+	}
+  }
+}
+
+bool HiZBuffer::Occluded(const Real *depth_buffer, Real min_depth,
+						 int x_min, int y_min, int x_max, int y_max) {
+  if (x_min > x_max || y_min > y_max) return false;
+  for (int by = y_min / kBlockSize; by <= y_max / kBlockSize; by++) {
+	for (int bx = x_min / kBlockSize; bx <= x_max / kBlockSize; bx++) {
+	  int index = by * num_x_ + bx;
+	  // the farthest depth is never nearer than the nearest one
+	  if (min_depth - min_depth_[index] <= kHiZMargin) return false;
+	  if (dirty_[index]) Rescan(depth_buffer, bx, by);
+	  if (min_depth - max_depth_[index] <= kHiZMargin) return false;
+	}
+  }
+  return true;
+}
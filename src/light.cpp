@@ -2,75 +2,75 @@
 #include "math_util.h"
 
 // normal distribution function
-double Light::NDF(const Vector4d &n, const Vector4d &h, double roughness) {
-  double a = roughness * roughness;
-  double a2 = a * a;
-  double n_dot_h = std::max(n.Dot(h), 0.0);
-  double n_dot_h2 = n_dot_h * n_dot_h;
-
-  double nom = a2;
-  double denom = (n_dot_h2 * (a2 - 1.0) + 1.0);
+Real Light::NDF(const Vector4r &n, const Vector4r &h, Real roughness) {
+  Real a = roughness * roughness;
+  Real a2 = a * a;
+  Real n_dot_h = std::max<Real>(n.Dot(h), 0);
+  Real n_dot_h2 = n_dot_h * n_dot_h;
+
+  Real nom = a2;
+  Real denom = (n_dot_h2 * (a2 - 1.0) + 1.0);
   denom = kPI * denom * denom;
 
   return nom / denom;
 }
 // fresnel function
-Vector4d Light::FE(const Vector4d &f0, const Vector4d &h, const Vector4d &v) {
-  double h_dot_v = std::max(h.Dot(v), 0.0);
-  Vector4d vec(1.0, 1.0, 1.0, 0.0);
+Vector4r Light::FE(const Vector4r &f0, const Vector4r &h, const Vector4r &v) {
+  Real h_dot_v = std::max<Real>(h.Dot(v), 0);
+  Vector4r vec(1.0, 1.0, 1.0, 0.0);
 
   return f0 + (vec - f0) * std::pow(1.0 - h_dot_v, 5);
 }
 // geometry function
-double Light::GE(const Vector4d &n, const Vector4d &v, const Vector4d &l, double roughness) {
-  double n_dot_v = std::max(n.Dot(v), 0.0);
-  double n_dot_l = std::max(n.Dot(l), 0.0);
-  double ggx2 = GESub(n_dot_v, roughness);
-  double ggx1 = GESub(n_dot_l, roughness);
+Real Light::GE(const Vector4r &n, const Vector4r &v, const Vector4r &l, Real roughness) {
+  Real n_dot_v = std::max<Real>(n.Dot(v), 0);
+  Real n_dot_l = std::max<Real>(n.Dot(l), 0);
+  Real ggx2 = GESub(n_dot_v, roughness);
+  Real ggx1 = GESub(n_dot_l, roughness);
 
   return ggx1 * ggx2;
 }
 
-double Light::GESub(double n_dot_v, double roughness) {
-  double r = roughness + 1.0;
-  double k = (r * r) / 8.0;
+Real Light::GESub(Real n_dot_v, Real roughness) {
+  Real r = roughness + 1.0;
+  Real k = (r * r) / 8.0;
 
-  double nom = n_dot_v;
-  double denom = n_dot_v * (1.0 - k) + k;
+  Real nom = n_dot_v;
+  Real denom = n_dot_v * (1.0 - k) + k;
 
   return nom / denom;
 }
 
-Vector4d DirectionLight::Lighting(const Vector4d &normal,
-								  const Vector4d &pos,
-								  const Vector4d &view_pos,
-								  const Vector4d &albedo,
+Vector4r DirectionLight::Lighting(const Vector4r &normal,
+								  const Vector4r &pos,
+								  const Vector4r &view_pos,
+								  const Vector4r &albedo,
 								  bool occlude) {
   if (occlude)
 	return ambient_ * albedo;
-  double cos_theta;
-  Vector4d ambient, diffuse, specular, view_dir, reflect_dir;
+  Real cos_theta;
+  Vector4r ambient, diffuse, specular, view_dir, reflect_dir;
   // calculate ambient coefficient
   ambient = ambient_;
   // calculate diffuse coefficient
-  cos_theta = std::max(0.0, light_dir_.Dot(normal));
+  cos_theta = std::max<Real>(0, light_dir_.Dot(normal));
   diffuse = diffuse_ * cos_theta;
   // calculate specular coefficient
   view_dir = (view_pos - pos).Normalize();
   reflect_dir = Reflect(light_dir_, normal).Normalize();
-  cos_theta = std::max(0.0, view_dir.Dot(reflect_dir));
+  cos_theta = std::max<Real>(0, view_dir.Dot(reflect_dir));
   specular = specular_ * std::pow(cos_theta, 32);
   // merge together
   return (ambient + diffuse + specular) * albedo;
 }
 
-Vector4d PointLight::Lighting(const Vector4d &normal,
-							  const Vector4d &pos,
-							  const Vector4d &view_pos,
-							  const Vector4d &albedo,
+Vector4r PointLight::Lighting(const Vector4r &normal,
+							  const Vector4r &pos,
+							  const Vector4r &view_pos,
+							  const Vector4r &albedo,
 							  bool occlude) {
-  double cos_theta, distance, attenuation;
-  Vector4d ambient, diffuse, specular, view_dir, reflect_dir, light_dir;
+  Real cos_theta, distance, attenuation;
+  Vector4r ambient, diffuse, specular, view_dir, reflect_dir, light_dir;
   // calculate attenuation
   light_dir = light_pos_ - pos;
   distance = light_dir.Norm();
@@ -81,94 +81,94 @@ Vector4d PointLight::Lighting(const Vector4d &normal,
   ambient = ambient_;
   // calculate diffuse coefficient
   light_dir = light_dir.Normalize();
-  cos_theta = std::max(0.0, light_dir.Dot(normal));
+  cos_theta = std::max<Real>(0, light_dir.Dot(normal));
   diffuse = diffuse_ * cos_theta;
   // calculate specular coefficient
   view_dir = (view_pos - pos).Normalize();
   reflect_dir = Reflect(light_dir, normal).Normalize();
-  cos_theta = std::max(0.0, view_dir.Dot(reflect_dir));
+  cos_theta = std::max<Real>(0, view_dir.Dot(reflect_dir));
   specular = specular_ * std::pow(cos_theta, 32);
   // merge together
   return (ambient + diffuse + specular) * attenuation * albedo;
 }
 
-Vector4d SpotLight::Lighting(const Vector4d &normal,
-							 const Vector4d &pos,
-							 const Vector4d &view_pos,
-							 const Vector4d &albedo,
+Vector4r SpotLight::Lighting(const Vector4r &normal,
+							 const Vector4r &pos,
+							 const Vector4r &view_pos,
+							 const Vector4r &albedo,
 							 bool occlude) {
   if (occlude)
-	return Vector4d(0.0, 0.0, 0.0, 1.0);
-  double cos_theta, intensity;
-  Vector4d diffuse, specular, view_dir, reflect_dir, light_dir;
+	return Vector4r(0.0, 0.0, 0.0, 1.0);
+  Real cos_theta, intensity;
+  Vector4r diffuse, specular, view_dir, reflect_dir, light_dir;
   // Determine if the viewpoint is inside the cone
   light_dir = (light_pos_ - pos).Normalize();
   cos_theta = light_dir.Dot(spot_dir_);
   intensity = (cos_theta - outer_cutoff_) / (inner_cutoff_ - outer_cutoff_);
   Clamp(intensity, 0.0, 1.0);
   // calculate diffuse coefficient
-  cos_theta = std::max(0.0, light_dir.Dot(normal));
+  cos_theta = std::max<Real>(0, light_dir.Dot(normal));
   diffuse = diffuse_ * cos_theta;
   // calculate specular coefficient
   view_dir = (view_pos - pos).Normalize();
   reflect_dir = Reflect(light_dir, normal).Normalize();
-  cos_theta = std::max(0.0, view_dir.Dot(reflect_dir));
+  cos_theta = std::max<Real>(0, view_dir.Dot(reflect_dir));
   specular = specular_ * std::pow(cos_theta, 32);
   // merge together
   return (diffuse + specular) * intensity * albedo;
 }
 
-Vector4d DirectionLight::PBRLighting(const Vector4d &normal,
-									 const Vector4d &pos,
-									 const Vector4d &view_pos,
-									 const Vector4d &albedo,
+Vector4r DirectionLight::PBRLighting(const Vector4r &normal,
+									 const Vector4r &pos,
+									 const Vector4r &view_pos,
+									 const Vector4r &albedo,
 									 bool occlude) {
-  Vector4d view_dir = (view_pos - pos).Normalize();
-  Vector4d half_vec = (view_dir + light_dir_).Normalize();
-  Vector4d f0(0.04, 0.04, 0.04, 0.0);
-  double roughness = 0.0;
-  double cos_theta_i = std::max(light_dir_.Dot(normal), 0.0);
-  double cos_theta_o = std::max(view_dir.Dot(normal), 0.0);
+  Vector4r view_dir = (view_pos - pos).Normalize();
+  Vector4r half_vec = (view_dir + light_dir_).Normalize();
+  Vector4r f0(0.04, 0.04, 0.04, 0.0);
+  Real roughness = 0.0;
+  Real cos_theta_i = std::max<Real>(light_dir_.Dot(normal), 0);
+  Real cos_theta_o = std::max<Real>(view_dir.Dot(normal), 0);
 
-  Vector4d f = FE(f0, half_vec, view_dir);
-  double d = NDF(normal, half_vec, roughness);
-  double g = GE(normal, view_dir, light_dir_, roughness);
+  Vector4r f = FE(f0, half_vec, view_dir);
+  Real d = NDF(normal, half_vec, roughness);
+  Real g = GE(normal, view_dir, light_dir_, roughness);
 
-  Vector4d vec(1.0, 1.0, 1.0, 0.0);
-  Vector4d diffuse = (vec - f) * (albedo / kPI);
-  Vector4d specular = (d * f * g) / (4.0 * cos_theta_i * cos_theta_o + 0.001);
+  Vector4r vec(1.0, 1.0, 1.0, 0.0);
+  Vector4r diffuse = (vec - f) * (albedo / kPI);
+  Vector4r specular = (d * f * g) / (4.0 * cos_theta_i * cos_theta_o + 0.001);
 
   return (diffuse + specular) * light_color_ * cos_theta_i;
 }
 
-Vector4d PointLight::PBRLighting(const Vector4d &normal,
-								 const Vector4d &pos,
-								 const Vector4d &view_pos,
-								 const Vector4d &albedo,
+Vector4r PointLight::PBRLighting(const Vector4r &normal,
+								 const Vector4r &pos,
+								 const Vector4r &view_pos,
+								 const Vector4r &albedo,
 								 bool occlude) {
-  Vector4d light_dir = (light_pos_ - pos).Normalize();
-  Vector4d view_dir = (view_pos - pos).Normalize();
-  Vector4d half_vec = (view_dir + light_dir).Normalize();
-  Vector4d f0(0.04, 0.04, 0.04, 0.0);
-  double roughness = 0.0;
-  double cos_theta_i = std::max(light_dir.Dot(normal), 0.0);
-  double cos_theta_o = std::max(view_dir.Dot(normal), 0.0);
-
-  Vector4d f = FE(f0, half_vec, view_dir);
-  double d = NDF(normal, half_vec, roughness);
-  double g = GE(normal, view_dir, light_dir, roughness);
-
-  Vector4d vec(1.0, 1.0, 1.0, 0.0);
-  Vector4d diffuse = (vec - f) * (albedo / kPI);
-  Vector4d specular = (d * f * g) / (4.0 * cos_theta_i * cos_theta_o + 0.001);
+  Vector4r light_dir = (light_pos_ - pos).Normalize();
+  Vector4r view_dir = (view_pos - pos).Normalize();
+  Vector4r half_vec = (view_dir + light_dir).Normalize();
+  Vector4r f0(0.04, 0.04, 0.04, 0.0);
+  Real roughness = 0.0;
+  Real cos_theta_i = std::max<Real>(light_dir.Dot(normal), 0);
+  Real cos_theta_o = std::max<Real>(view_dir.Dot(normal), 0);
+
+  Vector4r f = FE(f0, half_vec, view_dir);
+  Real d = NDF(normal, half_vec, roughness);
+  Real g = GE(normal, view_dir, light_dir, roughness);
+
+  Vector4r vec(1.0, 1.0, 1.0, 0.0);
+  Vector4r diffuse = (vec - f) * (albedo / kPI);
+  Vector4r specular = (d * f * g) / (4.0 * cos_theta_i * cos_theta_o + 0.001);
 
   return (diffuse + specular) * light_color_ * cos_theta_i;
 }
 
-Vector4d SpotLight::PBRLighting(const Vector4d &normal,
-								const Vector4d &pos,
-								const Vector4d &view_pos,
-								const Vector4d &albedo,
+Vector4r SpotLight::PBRLighting(const Vector4r &normal,
+								const Vector4r &pos,
+								const Vector4r &view_pos,
+								const Vector4r &albedo,
 								bool occlude) {
-  return Vector4d{};
+  return Vector4r{};
 }
\ No newline at end of file
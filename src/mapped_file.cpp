@@ -0,0 +1,87 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	: data_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr) {}
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+					  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size)) {
+	Close();
+	return false;
+  }
+  size_ = static_cast<std::size_t>(size.QuadPart);
+  // a mapping of zero bytes cannot be created
+  if (size_ == 0) return true;
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_) data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+	Close();
+	return false;
+  }
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+  file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), fd_(-1) {}
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  fd_ = open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) return false;
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+	Close();
+	return false;
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ == 0) return true;
+  void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (data == MAP_FAILED) {
+	Close();
+	return false;
+  }
+  data_ = static_cast<const char *>(data);
+  // the parsers read front to back
+  madvise(data, size_, MADV_SEQUENTIAL);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) munmap(const_cast<char *>(data_), size_);
+  if (fd_ >= 0) close(fd_);
+  data_ = nullptr;
+  size_ = 0;
+  fd_ = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+  Close();
+}
@@ -1,47 +1,272 @@
 #include "mesh.h"
 
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <unordered_map>
+
+#include "obj_parser.h"
+
+// Binary mesh cache written next to the OBJ file and mapped on later loads.
+// The header is followed by the vertex and index streams, each 16-byte aligned,
+// stored exactly as VertexIn and int are laid out in memory.
+const char kMeshCacheMagic[8] = {'S', 'R', 'M', 'E', 'S', 'H', '\0', '\0'};
+const uint32_t kMeshCacheVersion = 1;
+const uint64_t kMeshCacheAlignment = 16;
+
+struct MeshCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t real_size;         // sizeof(Real) of the build that wrote it
+  uint32_t vertex_size;       // sizeof(VertexIn)
+  uint32_t num_vertices;
+  uint32_t num_indices;
+  uint32_t padding;
+  uint64_t source_size;       // size and modification time of the OBJ it was built from
+  int64_t source_mtime;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  double aabb_min[3], aabb_max[3];   // model space
+};
+
+static uint64_t AlignUp(uint64_t offset) {
+  return (offset + kMeshCacheAlignment - 1) / kMeshCacheAlignment * kMeshCacheAlignment;
+}
+
+// corners with equal indices share a vertex
+struct ObjCornerHash {
+  std::size_t operator()(const ObjCorner &corner) const {
+	std::size_t h = static_cast<std::size_t>(corner.position) * 73856093u;
+	h ^= static_cast<std::size_t>(corner.texcoord) * 19349663u;
+	h ^= static_cast<std::size_t>(corner.normal) * 83492791u;
+	return h;
+  }
+};
+
+struct ObjCornerEqual {
+  bool operator()(const ObjCorner &lhs, const ObjCorner &rhs) const {
+	return lhs.position == rhs.position && lhs.texcoord == rhs.texcoord && lhs.normal == rhs.normal;
+  }
+};
+
+// element i of attributes, or fallback when the face left it out
+template<typename T>
+static T Attribute(const std::vector<T> &attributes, int i, const T &fallback) {
+  return i >= 0 && i < attributes.size() ? attributes[i] : fallback;
+}
+
+// Tipsify (Sander et al. 2007) for the post-transform cache, see OptimizeIndices below
+static void OptimizeIndices(std::vector<int> &indices, int num_vertices, int cache_size = 16);
+static void OptimizeVertexOrder(std::vector<VertexIn> &vertices, std::vector<int> &indices);
 
 void Mesh::LoadObjFile(const std::string &path) {
-  std::ifstream ifs;
-  std::string line, key, x, y, z;
-  std::vector<Vector4d> position;
-  std::vector<Vector2d> texcoord;
-  std::vector<Vector4d> normal;
-  std::vector<std::string> split_index;
-  int index[3];
-
-  ifs.open(path);
-  if (ifs.fail()) printf("Failed to load obj file.\n");
-
-  while (std::getline(ifs, line)) {
-	std::istringstream iss(line);
-	iss >> key;
-	if (key == "v") {
-	  iss >> x >> y >> z;
-	  position.emplace_back(std::stod(x), std::stod(y), std::stod(z));
-	} else if (key == "vt") {
-	  iss >> x >> y;
-	  texcoord.emplace_back(std::stod(x), std::stod(y));
-	} else if (key == "vn") {
-	  iss >> x >> y >> z;
-	  normal.emplace_back(std::stod(x), std::stod(y), std::stod(z), 0);
-	} else if (key == "f") {
-	  while (iss >> x) {
-		split_index = Split(x);
-		for (int i = 0; i < 3; i++) {
-		  index[i] = std::stoi(split_index[i]);
+  auto start = std::chrono::steady_clock::now();
+  // float and double builds lay vertices out differently
+  std::string cache_path = path + (sizeof(Real) == sizeof(float) ? ".f32" : ".f64") + ".meshcache";
+  if (LoadMeshCache(path, cache_path)) {
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Loaded %s from mesh cache in %.2f ms, %d vertices, %d triangles\n", path.c_str(), ms,
+		   static_cast<int>(vertices.size()), static_cast<int>(indices.size() / 3));
+	return;
+  }
+
+  ObjData obj;
+  if (!ParseObjFile(path, obj)) {
+	printf("Failed to load obj file.\n");
+	return;
+  }
+
+  // weld corners that repeat an earlier one
+  std::vector<VertexIn> vertex_data;
+  std::vector<int> index_data;
+  std::unordered_map<ObjCorner, int, ObjCornerHash, ObjCornerEqual> corner_vertex;
+  corner_vertex.reserve(obj.corners.size());
+  index_data.reserve(obj.corners.size());
+  for (int i = 0; i < obj.corners.size(); i++) {
+	const ObjCorner &corner = obj.corners[i];
+	auto it = corner_vertex.find(corner);
+	if (it != corner_vertex.end()) {
+	  index_data.push_back(it->second);
+	  continue;
+	}
+	corner_vertex.emplace(corner, vertex_data.size());
+	index_data.push_back(vertex_data.size());
+	vertex_data.emplace_back(Attribute(obj.positions, corner.position, Vector4r()),
+							 Vector4r(1.0, 1.0, 1.0),
+							 Attribute(obj.normals, corner.normal, Vector4r(0, 0, 0, 0)),
+							 Attribute(obj.texcoords, corner.texcoord, Vector2r()));
+  }
+
+  OptimizeIndices(index_data, vertex_data.size());
+  OptimizeVertexOrder(vertex_data, index_data);
+  local_aabb_ = AABB();
+  for (int i = 0; i < vertex_data.size(); i++)
+	local_aabb_ = AABB::Union(local_aabb_, vertex_data[i].local_position);
+  vertices.Assign(std::move(vertex_data));
+  indices.Assign(std::move(index_data));
+  WriteMeshCache(path, cache_path);
+
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  double mb = obj.file_size / (1024.0 * 1024.0);
+  printf("Loaded %s: %.2f MB in %.1f ms (%.1f MB/s), %d vertices, %d triangles\n", path.c_str(), mb, ms,
+		 mb / (ms / 1000.0), static_cast<int>(vertices.size()), static_cast<int>(indices.size() / 3));
+}
+
+// maps cache_path and points vertices and indices into it, fails when the
+// cache is missing, truncated, from another build or older than the OBJ
+bool Mesh::LoadMeshCache(const std::string &obj_path, const std::string &cache_path) {
+  struct stat source;
+  if (stat(obj_path.c_str(), &source) != 0) return false;
+  if (!cache_file_.Open(cache_path)) return false;
+
+  MeshCacheHeader header;
+  bool valid = cache_file_.size() >= sizeof(header);
+  if (valid) {
+	memcpy(&header, cache_file_.data(), sizeof(header));
+	valid = memcmp(header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic)) == 0
+		&& header.version == kMeshCacheVersion
+		&& header.real_size == sizeof(Real)
+		&& header.vertex_size == sizeof(VertexIn)
+		&& header.source_size == static_cast<uint64_t>(source.st_size)
+		&& header.source_mtime == static_cast<int64_t>(source.st_mtime)
+		&& header.vertex_offset % kMeshCacheAlignment == 0
+		&& header.index_offset % kMeshCacheAlignment == 0
+		&& header.vertex_offset + uint64_t(header.num_vertices) * sizeof(VertexIn) <= cache_file_.size()
+		&& header.index_offset + uint64_t(header.num_indices) * sizeof(int) <= cache_file_.size();
+  }
+  if (!valid) {
+	cache_file_.Close();
+	return false;
+  }
+
+  vertices.View(reinterpret_cast<const VertexIn *>(cache_file_.data() + header.vertex_offset),
+				header.num_vertices);
+  indices.View(reinterpret_cast<const int *>(cache_file_.data() + header.index_offset),
+			   header.num_indices);
+  local_aabb_ = AABB(Vector4r(header.aabb_min[0], header.aabb_min[1], header.aabb_min[2]),
+					 Vector4r(header.aabb_max[0], header.aabb_max[1], header.aabb_max[2]));
+  return true;
+}
+
+// best effort, a read-only asset directory just means no cache
+void Mesh::WriteMeshCache(const std::string &obj_path, const std::string &cache_path) {
+  struct stat source;
+  if (stat(obj_path.c_str(), &source) != 0) return;
+
+  MeshCacheHeader header = {};
+  memcpy(header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic));
+  header.version = kMeshCacheVersion;
+  header.real_size = sizeof(Real);
+  header.vertex_size = sizeof(VertexIn);
+  header.num_vertices = vertices.size();
+  header.num_indices = indices.size();
+  header.source_size = source.st_size;
+  header.source_mtime = source.st_mtime;
+  header.vertex_offset = AlignUp(sizeof(header));
+  header.index_offset = AlignUp(header.vertex_offset + vertices.size() * sizeof(VertexIn));
+  Vector4r aabb_min = local_aabb_.min(), aabb_max = local_aabb_.max();
+  header.aabb_min[0] = aabb_min.x, header.aabb_min[1] = aabb_min.y, header.aabb_min[2] = aabb_min.z;
+  header.aabb_max[0] = aabb_max.x, header.aabb_max[1] = aabb_max.y, header.aabb_max[2] = aabb_max.z;
+
+  std::ofstream ofs(cache_path, std::ios::binary | std::ios::trunc);
+  if (!ofs) return;
+  const char zeros[kMeshCacheAlignment] = {};
+  ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  ofs.write(zeros, header.vertex_offset - sizeof(header));
+  ofs.write(reinterpret_cast<const char *>(vertices.data()), vertices.size() * sizeof(VertexIn));
+  ofs.write(zeros, header.index_offset - header.vertex_offset - vertices.size() * sizeof(VertexIn));
+  ofs.write(reinterpret_cast<const char *>(indices.data()), indices.size() * sizeof(int));
+}
+
+// Tipsify (Sander et al. 2007): fan out around one vertex at a time and pick the
+// next fan centre among the recently used vertices that are still in the cache
+static void OptimizeIndices(std::vector<int> &indices, int num_vertices, int cache_size) {
+  int num_triangles = indices.size() / 3;
+  if (num_triangles == 0) return;
+
+  // triangles adjacent to every vertex, packed into one array
+  std::vector<int> live(num_vertices, 0), offset(num_vertices + 1, 0), adjacency(3 * num_triangles);
+  for (int i = 0; i < 3 * num_triangles; i++)
+	live[indices[i]]++;
+  for (int v = 0; v < num_vertices; v++)
+	offset[v + 1] = offset[v] + live[v];
+  std::vector<int> fill(offset.begin(), offset.end() - 1);
+  for (int i = 0; i < 3 * num_triangles; i++)
+	adjacency[fill[indices[i]]++] = i / 3;
+
+  std::vector<int> cache_time(num_vertices, 0), dead_end, candidates;
+  std::vector<bool> emitted(num_triangles, false);
+  std::vector<int> optimized;
+  optimized.reserve(3 * num_triangles);
+  int time = cache_size + 1, cursor = 0, fan = 0;
+
+  while (fan >= 0) {
+	candidates.clear();
+	for (int i = offset[fan]; i < offset[fan + 1]; i++) {
+	  int t = adjacency[i];
+	  if (emitted[t]) continue;
+	  for (int k = 0; k < 3; k++) {
+		int v = indices[3 * t + k];
+		optimized.push_back(v);
+		dead_end.push_back(v);
+		candidates.push_back(v);
+		live[v]--;
+		if (time - cache_time[v] > cache_size) {
+		  cache_time[v] = time;
+		  time++;
 		}
-		indices.push_back(vertices.size());
-		vertices.emplace_back(position[index[0] - 1], Vector4d(1.0, 1.0, 1.0),
-							  normal[index[2] - 1], texcoord[index[1] - 1]);
 	  }
+	  emitted[t] = true;
+	}
+
+	// prefer the oldest candidate that will still be cached after its own fan
+	fan = -1;
+	int best = -1;
+	for (int i = 0; i < candidates.size(); i++) {
+	  int v = candidates[i];
+	  if (live[v] <= 0) continue;
+	  int priority = 0;
+	  if (time - cache_time[v] + 2 * live[v] <= cache_size)
+		priority = time - cache_time[v];
+	  if (priority > best) {
+		best = priority;
+		fan = v;
+	  }
+	}
+	// dead end, back up through recent vertices, then scan forward
+	while (fan < 0 && !dead_end.empty()) {
+	  int v = dead_end.back();
+	  dead_end.pop_back();
+	  if (live[v] > 0) fan = v;
+	}
+	while (fan < 0 && cursor < num_vertices) {
+	  if (live[cursor] > 0) fan = cursor;
+	  cursor++;
 	}
   }
 
-  ifs.close();
+  indices.swap(optimized);
+}
+
+// renumber vertices in order of first use so that the vertex stage reads memory linearly,
+// vertices no triangle refers to are dropped
+static void OptimizeVertexOrder(std::vector<VertexIn> &vertices, std::vector<int> &indices) {
+  std::vector<int> remap(vertices.size(), -1);
+  std::vector<VertexIn> ordered;
+  ordered.reserve(vertices.size());
+  for (int i = 0; i < indices.size(); i++) {
+	int &v = remap[indices[i]];
+	if (v < 0) {
+	  v = ordered.size();
+	  ordered.push_back(vertices[indices[i]]);
+	}
+	indices[i] = v;
+  }
+  vertices.swap(ordered);
 }
 
 void Mesh::LoadAlbedoTexture(const std::string &path) {
@@ -58,15 +283,3 @@ void Mesh::LoadAABB() {
 	aabb_ = AABB::Union(aabb_, model_matrix * vertices[i].local_position);
   }
 }
-
-std::vector<std::string> Mesh::Split(const std::string &str, const std::string &delimiter) {
-  std::vector<std::string> split_str;
-  std::size_t pos1 = str.find_first_not_of(delimiter, 0);
-  std::size_t pos2 = str.find_first_of(delimiter, pos1);
-  while (pos1 != std::string::npos || pos2 != std::string::npos) {
-	split_str.emplace_back(str.substr(pos1, pos2 - pos1));
-	pos1 = str.find_first_not_of(delimiter, pos2);
-	pos2 = str.find_first_of(delimiter, pos1);
-  }
-  return split_str;
-}
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "clipping.h"
+#include "light.h"
+#include "matrix.h"
+#include "raster_simd.h"
+#include "rasterizer.h"
+#include "texture.h"
+#include "vector.h"
+
+// Inputs per kernel, small enough to stay in L2 so the kernels are measured and not memory
+const int kNumInputs = 4096;
+const int kScreenSize = 512;
+
+// results are summed in here so the compiler cannot drop the kernels
+static volatile double g_sink;
+
+static double min_seconds = 0.2;
+static std::string filter;
+
+// Calls run() until min_seconds have passed, three times, and prints the best
+// time per operation. run() performs ops operations and returns a checksum.
+template<typename Func>
+static void Bench(const std::string &name, int ops, Func run) {
+  if (!filter.empty() && name.find(filter) == std::string::npos) return;
+  double best = 1e30;
+  for (int round = 0; round < 3; round++) {
+	long long calls = 0;
+	double checksum = 0, elapsed = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (elapsed < min_seconds) {
+	  checksum += run();
+	  calls++;
+	  elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	g_sink = g_sink + checksum;
+	best = std::min(best, elapsed * 1e9 / (calls * ops));
+  }
+  printf("%-32s %10.2f ns/op %10.2f Mop/s\n", name.c_str(), best, 1e3 / best);
+}
+
+static Vector4r RandomVector(std::mt19937 &rng, Real w) {
+  std::uniform_real_distribution<Real> dist(-1.0, 1.0);
+  return Vector4r(dist(rng), dist(rng), dist(rng), w);
+}
+
+static Vector4r RandomDirection(std::mt19937 &rng) {
+  Vector4r v;
+  do v = RandomVector(rng, 0); while (v.Dot(v) < 1e-4);
+  return v.Normalize();
+}
+
+// a screen-space triangle whose vertices lie within size pixels of a random centre
+static void RandomScreenTriangle(std::mt19937 &rng, Real size, VertexOut v[3]) {
+  std::uniform_real_distribution<Real> centre(size, kScreenSize - 1 - size), offset(-size, size),
+	  unit(0.0, 1.0);
+  Real cx = centre(rng), cy = centre(rng);
+  for (int k = 0; k < 3; k++) {
+	v[k].pixel_position = Vector4r(cx + offset(rng), cy + offset(rng), unit(rng), 1.0);
+	v[k].world_position = RandomVector(rng, 1.0);
+	v[k].view_position = RandomVector(rng, 1.0);
+	v[k].normal = RandomDirection(rng);
+	v[k].color = Vector4r(1.0, 1.0, 1.0, 1.0);
+	v[k].texcoord = Vector2r(unit(rng), unit(rng));
+	v[k].one_div_z = 0.5 + unit(rng);
+  }
+}
+
+// the rectangle the pipeline would rasterize: the triangle's bounding box, clamped to the screen
+struct Bounds {
+  int x_min, y_min, x_max, y_max;
+};
+
+static Bounds TriangleBounds(const VertexOut v[3]) {
+  const Vector4r &a = v[0].pixel_position, &b = v[1].pixel_position, &c = v[2].pixel_position;
+  Bounds bounds;
+  bounds.x_min = std::max(0, static_cast<int>(floor(std::min(a.x, std::min(b.x, c.x)))));
+  bounds.y_min = std::max(0, static_cast<int>(floor(std::min(a.y, std::min(b.y, c.y)))));
+  bounds.x_max = std::min(kScreenSize - 1, static_cast<int>(ceil(std::max(a.x, std::max(b.x, c.x)))));
+  bounds.y_max = std::min(kScreenSize - 1, static_cast<int>(ceil(std::max(a.y, std::max(b.y, c.y)))));
+  return bounds;
+}
+
+static void BenchMath(std::mt19937 &rng) {
+  std::vector<Matrix4r> matrices(kNumInputs);
+  std::vector<Vector4r> vectors(kNumInputs), others(kNumInputs);
+  for (int i = 0; i < kNumInputs; i++) {
+	matrices[i].SetRotationAxis(360.0 * (rng() % 1000) / 1000.0, Vector3r(0.3, 1.0, 0.2));
+	vectors[i] = RandomVector(rng, 1.0);
+	others[i] = RandomVector(rng, 0.0);
+  }
+
+  Bench("matrix4 * matrix4", kNumInputs, [&]() {
+	Matrix4r m = matrices[0];
+	for (int i = 1; i < kNumInputs; i++) m = matrices[i] * m;
+	return (m * vectors[0]).x;
+  });
+  Bench("matrix4 * vector4", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) sum += (matrices[i] * vectors[i]).x;
+	return sum;
+  });
+  Bench("vector4 dot", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) sum += vectors[i].Dot(others[i]);
+	return sum;
+  });
+  Bench("vector4 normalize", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) sum += others[i].Normalize().x;
+	return sum;
+  });
+  Bench("vector4 a + s * b", kNumInputs, [&]() {
+	Vector4r acc;
+	for (int i = 0; i < kNumInputs; i++) acc = acc + static_cast<Real>(0.5) * vectors[i];
+	return acc.x;
+  });
+  Bench("vector3 cross", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) {
+	  Vector3r a(vectors[i].x, vectors[i].y, vectors[i].z), b(others[i].x, others[i].y, others[i].z);
+	  sum += a.Cross(b).z;
+	}
+	return sum;
+  });
+}
+
+// edge function coverage alone, and coverage with depth test and interpolation
+// at every SIMD level the CPU supports, for small, medium and large triangles
+static void BenchRaster(std::mt19937 &rng) {
+  const int kNumTriangles = 1024;
+  const Real sizes[] = {4.0, 24.0, 128.0};
+  const char *size_names[] = {"small", "medium", "large"};
+  const char *level_names[] = {"scalar", "sse2", "avx2"};
+  std::vector<Real> depth_buffer(kScreenSize * kScreenSize, 1.0);
+
+  for (int s = 0; s < 3; s++) {
+	std::vector<VertexOut> triangles(3 * kNumTriangles);
+	std::vector<Bounds> bounds(kNumTriangles);
+	for (int i = 0; i < kNumTriangles; i++) {
+	  RandomScreenTriangle(rng, sizes[s], &triangles[3 * i]);
+	  bounds[i] = TriangleBounds(&triangles[3 * i]);
+	}
+
+	// covered pixels per triangle, to turn ns per triangle into ns per pixel
+	long long covered = 0;
+	for (int i = 0; i < kNumTriangles; i++) {
+	  const Vector4r &a = triangles[3 * i].pixel_position, &b = triangles[3 * i + 1].pixel_position,
+		  &c = triangles[3 * i + 2].pixel_position;
+	  RasterizeTriangle(Vector3r(a.x, a.y, a.z), Vector3r(b.x, b.y, b.z), Vector3r(c.x, c.y, c.z),
+						bounds[i].x_min, bounds[i].y_min, bounds[i].x_max, bounds[i].y_max,
+						[&](int, int, Real, Real, Real) { covered++; });
+	}
+	printf("%s triangles cover %.1f pixels on average, raster ops are triangles\n", size_names[s],
+		   static_cast<double>(covered) / kNumTriangles);
+
+	Bench(std::string("raster coverage ") + size_names[s], kNumTriangles, [&]() {
+	  Real sum = 0;
+	  for (int i = 0; i < kNumTriangles; i++) {
+		const Vector4r &a = triangles[3 * i].pixel_position, &b = triangles[3 * i + 1].pixel_position,
+			&c = triangles[3 * i + 2].pixel_position;
+		RasterizeTriangle(Vector3r(a.x, a.y, a.z), Vector3r(b.x, b.y, b.z), Vector3r(c.x, c.y, c.z),
+						  bounds[i].x_min, bounds[i].y_min, bounds[i].x_max, bounds[i].y_max,
+						  [&](int, int, Real alpha, Real, Real) { sum += alpha; });
+	  }
+	  return sum;
+	});
+
+	for (int level = static_cast<int>(SimdLevel::kSSE2);
+		 level <= static_cast<int>(DetectSimdLevel()); level++) {
+	  Bench(std::string("raster ") + level_names[level] + " " + size_names[s], kNumTriangles, [&]() {
+		Real sum = 0;
+		// reset the depth of every fragment so the next pass does the same work
+		auto shade = [&](int x, int y, const VertexOut &fragment) {
+		  sum += fragment.texcoord.x;
+		  depth_buffer[y * kScreenSize + x] = 1.0;
+		};
+		for (int i = 0; i < kNumTriangles; i++) {
+		  RasterizeTriangleSIMD(static_cast<SimdLevel>(level), DepthPass::kShade,
+								triangles[3 * i], triangles[3 * i + 1], triangles[3 * i + 2],
+								bounds[i].x_min, bounds[i].y_min, bounds[i].x_max, bounds[i].y_max,
+								depth_buffer.data(), kScreenSize, shade);
+		}
+		return sum;
+	  });
+	}
+  }
+}
+
+// triangles in clip space with w in [0.5, 1.5] and x, y, z spread over three
+// times the view volume, so most cross at least one plane
+static void BenchClipping(std::mt19937 &rng) {
+  std::uniform_real_distribution<Real> w_dist(0.5, 1.5), spread(-1.5, 1.5);
+  std::vector<VertexOut> triangles(3 * kNumInputs);
+  for (int i = 0; i < 3 * kNumInputs; i++) {
+	Real w = w_dist(rng);
+	triangles[i].clip_position = Vector4r(spread(rng) * w, spread(rng) * w, spread(rng) * w, w);
+	triangles[i].normal = RandomDirection(rng);
+  }
+
+  Bench("ClipWithPlane near", kNumInputs, [&]() {
+	ClipPolygon in, out;
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) {
+	  in.v[0] = triangles[3 * i], in.v[1] = triangles[3 * i + 1], in.v[2] = triangles[3 * i + 2];
+	  in.size = 3;
+	  ClipWithPlane(ClipPlane::kNear, in, out);
+	  sum += out.size;
+	}
+	return sum;
+  });
+  Bench("ClipTriangle guard band", kNumInputs, [&]() {
+	ClipPolygon polygon;
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) {
+	  ClipTriangle(triangles[3 * i], triangles[3 * i + 1], triangles[3 * i + 2], true, polygon);
+	  sum += polygon.size;
+	}
+	return sum;
+  });
+  Bench("ClipTriangle all planes", kNumInputs, [&]() {
+	ClipPolygon polygon;
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) {
+	  ClipTriangle(triangles[3 * i], triangles[3 * i + 1], triangles[3 * i + 2], false, polygon);
+	  sum += polygon.size;
+	}
+	return sum;
+  });
+}
+
+static void BenchTexture(std::mt19937 &rng, const std::string &path) {
+  Texture texture;
+  if (!texture.LoadImage(path.c_str())) {
+	printf("skipping Texture::Sample, %s not found (--texture)\n", path.c_str());
+	return;
+  }
+  std::uniform_real_distribution<Real> dist(0.0, 1.0);
+  std::vector<Vector2r> random_uvs(kNumInputs), coherent_uvs(kNumInputs);
+  for (int i = 0; i < kNumInputs; i++) {
+	random_uvs[i] = Vector2r(dist(rng), dist(rng));
+	// a scanline across the texture, like neighbouring fragments
+	coherent_uvs[i] = Vector2r(static_cast<Real>(i) / kNumInputs, 0.5);
+  }
+  Bench("Texture::Sample random", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) sum += texture.Sample(random_uvs[i]).x;
+	return sum;
+  });
+  Bench("Texture::Sample coherent", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++) sum += texture.Sample(coherent_uvs[i]).x;
+	return sum;
+  });
+}
+
+static void BenchLighting(std::mt19937 &rng) {
+  std::vector<Vector4r> normals(kNumInputs), positions(kNumInputs);
+  for (int i = 0; i < kNumInputs; i++) {
+	normals[i] = RandomDirection(rng);
+	positions[i] = RandomVector(rng, 1.0);
+  }
+  Vector4r view_pos(0.0, 0.0, 3.0, 1.0), albedo(0.8, 0.6, 0.4, 0.0);
+  DirectionLight direction_light(Vector4r(1.0, 1.0, 1.0, 0.0));
+  PointLight point_light(Vector4r(2.0, 2.0, 2.0, 1.0));
+
+  Bench("DirectionLight::PBRLighting", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++)
+	  sum += direction_light.PBRLighting(normals[i], positions[i], view_pos, albedo, false).x;
+	return sum;
+  });
+  Bench("PointLight::PBRLighting", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++)
+	  sum += point_light.PBRLighting(normals[i], positions[i], view_pos, albedo, false).x;
+	return sum;
+  });
+  Bench("DirectionLight::Lighting", kNumInputs, [&]() {
+	Real sum = 0;
+	for (int i = 0; i < kNumInputs; i++)
+	  sum += direction_light.Lighting(normals[i], positions[i], view_pos, albedo, false).x;
+	return sum;
+  });
+}
+
+int main(int argc, char *argv[]) {
+  std::string texture_path = "../assets/scene0/textures/azulejos/azulejos_normal.png";
+  for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+	else if (arg == "--min-time" && i + 1 < argc) min_seconds = atof(argv[++i]);
+	else if (arg == "--texture" && i + 1 < argc) texture_path = argv[++i];
+	else {
+	  printf("Usage: %s [--filter SUBSTRING] [--min-time SECONDS] [--texture PNG]\n", argv[0]);
+	  return arg == "--help" || arg == "-h" ? 0 : 1;
+	}
+  }
+
+  printf("%s build, best of 3 runs of at least %.2f s each\n",
+		 sizeof(Real) == sizeof(float) ? "float" : "double", min_seconds);
+  // fixed seed, every run sees the same inputs
+  std::mt19937 rng(12345);
+  BenchMath(rng);
+  BenchRaster(rng);
+  BenchClipping(rng);
+  BenchTexture(rng, texture_path);
+  BenchLighting(rng);
+  return 0;
+}
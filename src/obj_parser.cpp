@@ -0,0 +1,219 @@
+#include "obj_parser.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+// Chunks smaller than this are not worth a thread
+const std::size_t kMinChunkBytes = 4 << 20;
+
+static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+static const char *SkipSpace(const char *p, const char *end) {
+  while (p < end && IsSpace(*p)) p++;
+  return p;
+}
+
+static const char *SkipLine(const char *p, const char *end) {
+  const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+  return eol ? eol + 1 : end;
+}
+
+// Parses a signed integer at p, returns the end of the number or p when there is none
+static const char *ParseInt(const char *p, const char *end, int &value) {
+  const char *q = p;
+  bool negative = false;
+  if (q < end && (*q == '-' || *q == '+')) negative = *q++ == '-';
+  if (q == end || !IsDigit(*q)) return p;
+  int v = 0;
+  while (q < end && IsDigit(*q)) v = v * 10 + (*q++ - '0');
+  value = negative ? -v : v;
+  return q;
+}
+
+// Parses a decimal number at p, returns the end of the number or p when there is none.
+// Mantissas that fit in 53 bits with a power of ten up to 22 are exact in double, so
+// one multiply or divide rounds correctly. Anything else goes through strtod, which
+// keeps the result identical to std::stod.
+static const char *ParseDouble(const char *p, const char *end, double &value) {
+  static const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+								  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *q = p;
+  bool negative = false;
+  if (q < end && (*q == '-' || *q == '+')) negative = *q++ == '-';
+
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any = false;
+  while (q < end && IsDigit(*q)) {
+	if (digits < 19) mantissa = mantissa * 10 + (*q - '0'), digits += mantissa != 0;
+	else exponent++;
+	q++, any = true;
+  }
+  if (q < end && *q == '.') {
+	q++;
+	while (q < end && IsDigit(*q)) {
+	  if (digits < 19) mantissa = mantissa * 10 + (*q - '0'), digits += mantissa != 0, exponent--;
+	  q++, any = true;
+	}
+  }
+  if (!any) {
+	// inf, nan and other spellings
+	char *tail;
+	std::string token(p, std::find_if(p, end, [](char c) { return IsSpace(c) || c == '\n'; }));
+	value = strtod(token.c_str(), &tail);
+	return p + (tail - token.c_str());
+  }
+  if (q < end && (*q == 'e' || *q == 'E')) {
+	int e;
+	const char *r = ParseInt(q + 1, end, e);
+	if (r != q + 1) exponent += e, q = r;
+  }
+
+  if (digits < 19 && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+	double v = static_cast<double>(mantissa);
+	v = exponent < 0 ? v / kPow10[-exponent] : v * kPow10[exponent];
+	value = negative ? -v : v;
+  } else {
+	std::string token(p, q);
+	value = strtod(token.c_str(), nullptr);
+  }
+  return q;
+}
+
+// Counts of each statement before a chunk, used to resolve relative indices
+struct ObjCounts {
+  int positions, texcoords, normals;
+};
+
+static ObjCounts CountStatements(const char *p, const char *end) {
+  ObjCounts counts = {0, 0, 0};
+  while (p < end) {
+	p = SkipSpace(p, end);
+	if (end - p >= 2 && p[0] == 'v') {
+	  if (IsSpace(p[1])) counts.positions++;
+	  else if (p[1] == 't') counts.texcoords++;
+	  else if (p[1] == 'n') counts.normals++;
+	}
+	p = SkipLine(p, end);
+  }
+  return counts;
+}
+
+// turn a 1-based or negative OBJ index into a 0-based one, 0 means absent
+static int ResolveIndex(int index, int count) {
+  if (index > 0) return index - 1;
+  if (index < 0) return count + index;
+  return -1;
+}
+
+static void ParseChunk(const char *p, const char *end, ObjCounts base, ObjData &data) {
+  ObjCounts counts = base;
+  std::vector<ObjCorner> polygon;
+  double x, y, z;
+
+  while (p < end) {
+	p = SkipSpace(p, end);
+	if (end - p < 2) break;
+	if (p[0] == 'v' && IsSpace(p[1])) {
+	  p = ParseDouble(SkipSpace(p + 2, end), end, x);
+	  p = ParseDouble(SkipSpace(p, end), end, y);
+	  p = ParseDouble(SkipSpace(p, end), end, z);
+	  data.positions.emplace_back(x, y, z);
+	  counts.positions++;
+	} else if (p[0] == 'v' && p[1] == 't') {
+	  p = ParseDouble(SkipSpace(p + 2, end), end, x);
+	  p = ParseDouble(SkipSpace(p, end), end, y);
+	  data.texcoords.emplace_back(x, y);
+	  counts.texcoords++;
+	} else if (p[0] == 'v' && p[1] == 'n') {
+	  p = ParseDouble(SkipSpace(p + 2, end), end, x);
+	  p = ParseDouble(SkipSpace(p, end), end, y);
+	  p = ParseDouble(SkipSpace(p, end), end, z);
+	  data.normals.emplace_back(x, y, z, 0);
+	  counts.normals++;
+	} else if (p[0] == 'f' && IsSpace(p[1])) {
+	  // corners are p, p/t, p//n or p/t/n
+	  polygon.clear();
+	  p += 2;
+	  while (true) {
+		p = SkipSpace(p, end);
+		int v = 0, t = 0, n = 0;
+		const char *q = ParseInt(p, end, v);
+		if (q == p) break;
+		if (q < end && *q == '/') {
+		  q = ParseInt(q + 1, end, t);
+		  if (q < end && *q == '/') q = ParseInt(q + 1, end, n);
+		}
+		p = q;
+		ObjCorner corner = {ResolveIndex(v, counts.positions), ResolveIndex(t, counts.texcoords),
+							ResolveIndex(n, counts.normals)};
+		polygon.push_back(corner);
+	  }
+	  // fan triangulation
+	  for (int i = 1; i + 1 < polygon.size(); i++) {
+		data.corners.push_back(polygon[0]);
+		data.corners.push_back(polygon[i]);
+		data.corners.push_back(polygon[i + 1]);
+	  }
+	}
+	p = SkipLine(p, end);
+  }
+}
+
+bool ParseObjFile(const std::string &path, ObjData &data, int num_threads) {
+  MappedFile file;
+  if (!file.Open(path)) return false;
+  const char *begin = file.data(), *end = file.data() + file.size();
+  data.file_size = file.size();
+
+  if (num_threads <= 0)
+	num_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  int num_chunks = static_cast<int>(std::min<std::size_t>(num_threads,
+														  file.size() / kMinChunkBytes + 1));
+  if (num_chunks <= 1) {
+	ParseChunk(begin, end, ObjCounts{0, 0, 0}, data);
+	return true;
+  }
+
+  // split at line breaks
+  std::vector<const char *> bounds(num_chunks + 1, end);
+  bounds[0] = begin;
+  for (int i = 1; i < num_chunks; i++) {
+	const char *p = std::max(bounds[i - 1], begin + file.size() * i / num_chunks);
+	bounds[i] = p == begin ? p : SkipLine(p - 1, end);
+  }
+
+  // statements before each chunk, then every chunk can resolve its own indices
+  ThreadPool pool(num_chunks);
+  std::vector<ObjCounts> bases(num_chunks + 1, ObjCounts{0, 0, 0});
+  pool.ParallelFor(num_chunks, [&](int i) {
+	bases[i + 1] = CountStatements(bounds[i], bounds[i + 1]);
+  });
+  for (int i = 1; i <= num_chunks; i++) {
+	bases[i].positions += bases[i - 1].positions;
+	bases[i].texcoords += bases[i - 1].texcoords;
+	bases[i].normals += bases[i - 1].normals;
+  }
+  std::vector<ObjData> chunks(num_chunks);
+  pool.ParallelFor(num_chunks, [&](int i) {
+	ParseChunk(bounds[i], bounds[i + 1], bases[i], chunks[i]);
+  });
+
+  // concatenate in file order
+  data.positions.reserve(data.positions.size() + bases[num_chunks].positions);
+  data.texcoords.reserve(data.texcoords.size() + bases[num_chunks].texcoords);
+  data.normals.reserve(data.normals.size() + bases[num_chunks].normals);
+  for (int i = 0; i < num_chunks; i++) {
+	data.positions.insert(data.positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+	data.texcoords.insert(data.texcoords.end(), chunks[i].texcoords.begin(), chunks[i].texcoords.end());
+	data.normals.insert(data.normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+	data.corners.insert(data.corners.end(), chunks[i].corners.begin(), chunks[i].corners.end());
+  }
+  return true;
+}
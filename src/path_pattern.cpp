@@ -0,0 +1,46 @@
+#include "path_pattern.h"
+
+bool PathPattern::Parse(const std::string &text) {
+  prefix_.clear();
+  suffix_.clear();
+  width_ = 0;
+  bool has_field = false;
+  for (std::size_t i = 0; i < text.size(); i++) {
+	std::string &out = has_field ? suffix_ : prefix_;
+	if (text[i] != '%') {
+	  out += text[i];
+	  continue;
+	}
+	if (i + 1 < text.size() && text[i + 1] == '%') {
+	  out += '%';
+	  i++;
+	  continue;
+	}
+	if (has_field) return false;
+	// %d or %0Nd
+	std::size_t j = i + 1;
+	int width = 0;
+	if (j < text.size() && text[j] == '0') {
+	  j++;
+	  if (j >= text.size() || text[j] < '1' || text[j] > '9') return false;
+	  for (; j < text.size() && text[j] >= '0' && text[j] <= '9'; j++) {
+		width = width * 10 + (text[j] - '0');
+		if (width > kMaxWidth) return false;
+	  }
+	}
+	if (j >= text.size() || text[j] != 'd') return false;
+	width_ = width;
+	has_field = true;
+	i = j;
+  }
+  return has_field;
+}
+
+std::string PathPattern::Format(int number) const {
+  bool negative = number < 0;
+  std::string digits = std::to_string(negative ? -static_cast<long long>(number) : static_cast<long long>(number));
+  int padding = width_ - static_cast<int>(digits.size()) - (negative ? 1 : 0);
+  if (padding > 0) digits.insert(0, padding, '0');
+  if (negative) digits.insert(0, 1, '-');
+  return prefix_ + digits + suffix_;
+}
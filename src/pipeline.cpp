@@ -1,11 +1,28 @@
 #include "pipeline.h"
+#include "profiler.h"
 #include "shader.h"
 
+typedef std::chrono::steady_clock Clock;
+
+static double ElapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
 Pipeline::Pipeline(int width, int height) : width_(width), height_(height) {
   shader_ = new PhongShader();
-  shadow_map_ = new ShadowMap();
+  thread_pool_ = new ThreadPool();
+  shadow_map_ = new ShadowMap(thread_pool_);
   front_buffer_ = new FrameBuffer(width, height);
   back_buffer_ = new FrameBuffer(width, height);
+  gbuffer_ = nullptr;
+  hi_z_buffer_ = new HiZBuffer(width, height);
+  tile_grid_ = new TileGrid(width, height);
+  simd_level_ = DetectSimdLevel();
+  guard_band_ = true;
+  stage_timing_ = false;
+  depth_prepass_ = false;
+  deferred_ = false;
+  hi_z_culling_ = true;
   viewport_matrix_.SetViewport(0, 0, width, height);
   shader_->set_viewport_matrix(&viewport_matrix_);
 }
@@ -15,14 +32,22 @@ Pipeline::~Pipeline() {
   if (shadow_map_) delete shadow_map_;
   if (front_buffer_) delete front_buffer_;
   if (back_buffer_) delete back_buffer_;
+  if (gbuffer_) delete gbuffer_;
+  if (hi_z_buffer_) delete hi_z_buffer_;
+  if (thread_pool_) delete thread_pool_;
+  if (tile_grid_) delete tile_grid_;
   shader_ = nullptr;
   shadow_map_ = nullptr;
   front_buffer_ = nullptr;
   back_buffer_ = nullptr;
+  thread_pool_ = nullptr;
+  tile_grid_ = nullptr;
 }
 
-void Pipeline::ClearBuffer(const Vector4d &color) {
+void Pipeline::ClearBuffer(const Vector4r &color) {
+  Clock::time_point start = Clock::now();
   back_buffer_->ClearBuffer(color);
+  if (stage_timing_) stage_times_.clear += ElapsedMs(start);
 }
 
 void Pipeline::SwapBuffer() {
@@ -38,6 +63,7 @@ void Pipeline::SwitchMode(RenderMode mode) {
 	  shader_ = new LineShader();
 	  break;
 	case RenderMode::kFull:
+	case RenderMode::kDeferred:
 	  delete shader_;
 	  shader_ = new PhongShader();
 	  break;
@@ -51,391 +77,317 @@ void Pipeline::SwitchMode(RenderMode mode) {
 }
 
 void Pipeline::RenderShadowMap() {
-  shadow_map_->RenderShadowMap(viewport_matrix_);
+  Clock::time_point start = Clock::now();
+  shadow_map_->RenderShadowMap();
+  if (stage_timing_) stage_times_.shadow += ElapsedMs(start);
 }
 
 void Pipeline::Draw(RenderMode mode) {
   if (meshes_.empty()) return;
-
+  PROFILE_ZONE("Pipeline::Draw");
+
+  // front-end: transform every vertex, cull and clip every triangle, then bin it into screen tiles
+  triangles_.clear();
+  tile_grid_->Clear();
+  statistics_ = PipelineStatistics();
+  model_normal_matrices_.resize(meshes_.size());
+  mesh_bounds_.resize(meshes_.size());
+  ClipPolygon polygon;
   for (int i = 0; i < meshes_.size(); i++) {
-	shader_->albedo_texture(&(meshes_[i]->albedo_texture));
-	shader_->normal_texture(&(meshes_[i]->normal_texture));
+	const Mesh *mesh = meshes_[i];
+	// frustum culling, a mesh whose box is outside the view needs no vertex work
+	Matrix4r mvp = (*project_matrix_) * (*view_matrix_) * mesh->model_matrix;
+	if (BoxOutsideFrustum(mesh->local_aabb(), mvp)) {
+	  statistics_.meshes_culled++;
+	  statistics_.triangles_submitted += mesh->indices.size() / 3;
+	  continue;
+	}
 	shader_->set_model_matrix(&(meshes_[i]->model_matrix));
-	for (int j = 0; j < meshes_[i]->indices.size(); j += 3) {
-	  VertexIn p1, p2, p3;
-	  p1 = meshes_[i]->vertices[meshes_[i]->indices[j]];
-	  p2 = meshes_[i]->vertices[meshes_[i]->indices[j + 1]];
-	  p3 = meshes_[i]->vertices[meshes_[i]->indices[j + 2]];
-	  // construct TBN matrix for normal mapping
-	  shader_->TBN_matrix(p1, p2, p3);
-
-	  VertexOut v1, v2, v3;
-	  v1 = shader_->VertexShader(p1);
-	  v2 = shader_->VertexShader(p2);
-	  v3 = shader_->VertexShader(p3);
-
-	  if (BackFaceCulling(v1.view_position, v2.view_position, v3.view_position))
+	model_normal_matrices_[i] = shader_->model_normal_matrix();
+	mesh_bounds_[i] = MeshScreenBounds(mesh, mvp);
+
+	// vertex stage: every vertex of the mesh is shaded once, in parallel batches
+	Clock::time_point start = Clock::now();
+	PROFILE_ZONE("Vertex stage");
+	int num_vertices = mesh->vertices.size();
+	vertex_cache_.resize(num_vertices);
+	view_positions_.resize(num_vertices);
+	int num_batches = (num_vertices + kVertexBatchSize - 1) / kVertexBatchSize;
+	thread_pool_->ParallelFor(num_batches, [this, mesh, num_vertices](int batch) {
+	  PROFILE_ZONE("Vertex batch");
+	  int end = std::min(num_vertices, (batch + 1) * kVertexBatchSize);
+	  for (int v = batch * kVertexBatchSize; v < end; v++) {
+		VertexOut out = shader_->VertexShader(mesh->vertices[v]);
+		view_positions_[v] = out.view_position;
+		shader_->PerspectiveCorrection(out);
+		vertex_cache_[v] = out;
+	  }
+	});
+	if (stage_timing_) stage_times_.vertex += ElapsedMs(start);
+	statistics_.vertices_shaded += num_vertices;
+
+	// primitive assembly
+	start = Clock::now();
+	PROFILE_ZONE("Primitive assembly");
+	statistics_.triangles_submitted += mesh->indices.size() / 3;
+	for (int j = 0; j < mesh->indices.size(); j += 3) {
+	  int i1 = mesh->indices[j], i2 = mesh->indices[j + 1], i3 = mesh->indices[j + 2];
+	  if (BackFaceCulling(view_positions_[i1], view_positions_[i2], view_positions_[i3])) {
+		statistics_.backface_culled++;
 		continue;
-
-	  shader_->PerspectiveCorrection(v1);
-	  shader_->PerspectiveCorrection(v2);
-	  shader_->PerspectiveCorrection(v3);
-
-	  std::vector<VertexOut> in_vertices = HomogeneousClipping(v1, v2, v3);
-	  int size = in_vertices.size();
+	  }
+	  // construct TBN matrix for normal mapping
+	  shader_->TBN_matrix(mesh->vertices[i1], mesh->vertices[i2], mesh->vertices[i3]);
+
+	  const VertexOut &v1 = vertex_cache_[i1];
+	  const VertexOut &v2 = vertex_cache_[i2];
+	  const VertexOut &v3 = vertex_cache_[i3];
+	  ClipResult clip = ClipTriangle(v1, v2, v3, guard_band_, polygon);
+	  int size = polygon.size;
+	  if (clip == ClipResult::kRejected) {
+		statistics_.trivially_rejected++;
+	  } else if (clip == ClipResult::kClipped) {
+		statistics_.triangles_clipped++;
+		statistics_.clip_triangles_generated += std::max(size - 2, 0);
+	  }
 	  for (int k = 0; k < size; k++) {
-		PerspectiveDivision(in_vertices[k]);
-		in_vertices[k].pixel_position = viewport_matrix_ * in_vertices[k].clip_position;
+		PerspectiveDivision(polygon.v[k]);
+		polygon.v[k].pixel_position = viewport_matrix_ * polygon.v[k].clip_position;
 	  }
 	  for (int k = 0; k < size - 2; k++) {
-		int index0 = 0;
-		int index1 = k + 1;
-		int index2 = k + 2;
-		if (mode == RenderMode::kFull || mode == RenderMode::kPBR) {
-		  DrawTriangle(in_vertices[index0], in_vertices[index1], in_vertices[index2]);
-		} else {
-		  DrawLine(in_vertices[index0], in_vertices[index1]);
-		  DrawLine(in_vertices[index1], in_vertices[index2]);
-		  DrawLine(in_vertices[index2], in_vertices[index0]);
-		}
+		RasterTriangle triangle;
+		triangle.v[0] = polygon.v[0];
+		triangle.v[1] = polygon.v[k + 1];
+		triangle.v[2] = polygon.v[k + 2];
+		triangle.TBN_matrix = shader_->TBN_matrix();
+		triangle.mesh = i;
+
+		const Vector4r &a = triangle.v[0].pixel_position;
+		const Vector4r &b = triangle.v[1].pixel_position;
+		const Vector4r &c = triangle.v[2].pixel_position;
+		ScreenBounds &bounds = triangle.bounds;
+		bounds.valid = true;
+		bounds.x_min = floor(std::min(a.x, std::min(b.x, c.x)));
+		bounds.y_min = floor(std::min(a.y, std::min(b.y, c.y)));
+		bounds.x_max = ceil(std::max(a.x, std::max(b.x, c.x)));
+		bounds.y_max = ceil(std::max(a.y, std::max(b.y, c.y)));
+		bounds.min_depth = std::min(a.z, std::min(b.z, c.z));
+		tile_grid_->Bin(triangles_.size(), bounds.x_min, bounds.y_min, bounds.x_max, bounds.y_max);
+		triangles_.push_back(triangle);
 	  }
 	}
+	if (stage_timing_) stage_times_.clip += ElapsedMs(start);
+  }
+  statistics_.triangles_rasterized = triangles_.size();
+
+  // back-end: tiles own disjoint pixels and walk their bins in submission order,
+  // so the image is identical to drawing every triangle serially
+  deferred_ = mode == RenderMode::kDeferred;
+  if (deferred_ && !gbuffer_) gbuffer_ = new GBuffer(width_, height_);
+  Clock::time_point start = Clock::now();
+  tile_stats_.assign(tile_grid_->num_tiles(), TileStats());
+  thread_pool_->ParallelFor(tile_grid_->num_tiles(), [this, mode](int i) {
+	PROFILE_ZONE("DrawTile");
+	if (!stage_timing_) {
+	  DrawTile(mode, tile_grid_->tile(i), tile_stats_[i]);
+	  return;
+	}
+	Clock::time_point tile_start = Clock::now();
+	DrawTile(mode, tile_grid_->tile(i), tile_stats_[i]);
+	tile_stats_[i].total_ms = ElapsedMs(tile_start);
+  });
+  for (int i = 0; i < tile_stats_.size(); i++) {
+	const TileStats &stats = tile_stats_[i];
+	statistics_.triangles_occluded += stats.triangles_occluded;
+	statistics_.pixels_tested += stats.pixels_tested;
+	statistics_.depth_passed += stats.depth_passed;
+	statistics_.fragments_shaded += stats.fragments_shaded;
+	statistics_.pixels_covered += stats.pixels_covered;
+  }
+  statistics_.depth_failed = statistics_.pixels_tested - statistics_.depth_passed;
+  if (stage_timing_) {
+	double back_end = ElapsedMs(start), total = 0, fragment = 0;
+	for (int i = 0; i < tile_stats_.size(); i++) {
+	  const TileStats &stats = tile_stats_[i];
+	  total += stats.total_ms;
+	  if (stats.sampled > 0)
+		fragment += std::min(stats.total_ms, stats.sampled_ms / stats.sampled * stats.fragments_shaded);
+	}
+	double share = total > 0 ? fragment / total : 0;
+	stage_times_.fragment += back_end * share;
+	stage_times_.raster += back_end * (1 - share);
+  }
+
+  // deferred lighting runs once per covered pixel, after every tile has its nearest surfaces
+  if (deferred_) {
+	start = Clock::now();
+	thread_pool_->ParallelFor(tile_grid_->num_tiles(), [this](int i) {
+	  PROFILE_ZONE("LightTile");
+	  LightTile(tile_grid_->tile(i));
+	});
+	if (stage_timing_) stage_times_.fragment += ElapsedMs(start);
   }
 
   // DrawSkybox(mode);
 }
 
 // back face will return true
-bool Pipeline::BackFaceCulling(const Vector4d &v1, const Vector4d &v2, const Vector4d &v3) {
-  Vector3d a(v1.x, v1.y, v1.z);
-  Vector3d b(v2.x, v2.y, v2.z);
-  Vector3d c(v3.x, v3.y, v3.z);
-  Vector3d ab = b - a;
-  Vector3d ac = c - a;
-  Vector3d ae = -a;
-  Vector3d normal = ab.Cross(ac);
+bool Pipeline::BackFaceCulling(const Vector4r &v1, const Vector4r &v2, const Vector4r &v3) {
+  Vector3r a(v1.x, v1.y, v1.z);
+  Vector3r b(v2.x, v2.y, v2.z);
+  Vector3r c(v3.x, v3.y, v3.z);
+  Vector3r ab = b - a;
+  Vector3r ac = c - a;
+  Vector3r ae = -a;
+  Vector3r normal = ab.Cross(ac);
   return normal.Dot(ae) < 0;
 }
 
-// homogeneous clipping
-std::vector<VertexOut> Pipeline::HomogeneousClipping(const VertexOut &p1,
-													 const VertexOut &p2,
-													 const VertexOut &p3) {
-  int num_vertex = 3;
-  std::vector<VertexOut> vertices = {p1, p2, p3};
-  std::vector<VertexOut> in_vertices0, in_vertices1, in_vertices2, in_vertices3, in_vertices4,
-	  in_vertices5, in_vertices6;
-
-  // clip
-  if (num_vertex > 0)
-	in_vertices0 = ClipWithPlane(ClipPlane::kWZero, num_vertex, vertices);
-  if (num_vertex > 0)
-	in_vertices1 = ClipWithPlane(ClipPlane::kNear, num_vertex, in_vertices0);
-  if (num_vertex > 0)
-	in_vertices2 = ClipWithPlane(ClipPlane::kFar, num_vertex, in_vertices1);
-  if (num_vertex > 0)
-	in_vertices3 = ClipWithPlane(ClipPlane::kLeft, num_vertex, in_vertices2);
-  if (num_vertex > 0)
-	in_vertices4 = ClipWithPlane(ClipPlane::kRight, num_vertex, in_vertices3);
-  if (num_vertex > 0)
-	in_vertices5 = ClipWithPlane(ClipPlane::kTop, num_vertex, in_vertices4);
-  if (num_vertex > 0)
-	in_vertices6 = ClipWithPlane(ClipPlane::kBottom, num_vertex, in_vertices5);
-
-  return in_vertices6;
+void Pipeline::PerspectiveDivision(VertexOut &v) {
+  v.clip_position /= v.clip_position.w;
+  v.clip_position.w = 1.0;
+  // map [-1,1] to [0,1]
+  v.clip_position.z = (v.clip_position.z + 1.0) * 0.5;
 }
 
-// Clip a convex polygon with plane
-std::vector<VertexOut> Pipeline::ClipWithPlane(ClipPlane type,
-											   int &num_vertex,
-											   const std::vector<VertexOut> &vertices) {
-  std::vector<VertexOut> in_vertices;
-  VertexOut vertex;
-  int prev = num_vertex - 1;
-  int pdot = 0, idot, dot;
-  double t = 0;
-  double w1, w2, x1, x2, y1, y2, z1, z2;
-
-  switch (type) {
-	// drop the point whose w is small than zero
-	case ClipPlane::kWZero: idot = vertices[0].clip_position.w > 0 ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.w > 0 ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  w2 = vertices[i].clip_position.w;
-		  t = w1 / (w1 - w2);
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
-	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		w2 = vertices[0].clip_position.w;
-		t = w1 / (w1 - w2);
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
-	  }
-	  num_vertex = in_vertices.size();
-	  break;
-	case ClipPlane::kLeft:
-	  idot = vertices[0].clip_position.x > -vertices[0].clip_position.w ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.x > -vertices[i].clip_position.w ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  x1 = vertices[prev].clip_position.x;
-		  w2 = vertices[i].clip_position.w;
-		  x2 = vertices[i].clip_position.x;
-		  t = (w1 + x1) / ((w1 + x1) - (w2 + x2));
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
-	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		x1 = vertices[prev].clip_position.x;
-		w2 = vertices[0].clip_position.w;
-		x2 = vertices[0].clip_position.x;
-		t = (w1 + x1) / ((w1 + x1) - (w2 + x2));
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
-	  }
-	  num_vertex = in_vertices.size();
-	  break;
-	case ClipPlane::kRight:
-	  idot = vertices[0].clip_position.x < vertices[0].clip_position.w ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.x < vertices[i].clip_position.w ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  x1 = vertices[prev].clip_position.x;
-		  w2 = vertices[i].clip_position.w;
-		  x2 = vertices[i].clip_position.x;
-		  t = (w1 - x1) / ((w1 - x1) - (w2 - x2));
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
-	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		x1 = vertices[prev].clip_position.x;
-		w2 = vertices[0].clip_position.w;
-		x2 = vertices[0].clip_position.x;
-		t = (w1 - x1) / ((w1 - x1) - (w2 - x2));
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
-	  }
-	  num_vertex = in_vertices.size();
-	  break;
-	case ClipPlane::kNear:
-	  idot = vertices[0].clip_position.z > -vertices[0].clip_position.w ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.z > -vertices[i].clip_position.w ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  z1 = vertices[prev].clip_position.z;
-		  w2 = vertices[i].clip_position.w;
-		  z2 = vertices[i].clip_position.z;
-		  t = (w1 + z1) / ((w1 + z1) - (w2 + z2));
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
-	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		z1 = vertices[prev].clip_position.z;
-		w2 = vertices[0].clip_position.w;
-		z2 = vertices[0].clip_position.z;
-		t = (w1 + z1) / ((w1 + z1) - (w2 + z2));
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
-	  }
-	  num_vertex = in_vertices.size();
-	  break;
-	case ClipPlane::kFar: idot = vertices[0].clip_position.z < vertices[0].clip_position.w ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.z < vertices[i].clip_position.w ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  z1 = vertices[prev].clip_position.z;
-		  w2 = vertices[i].clip_position.w;
-		  z2 = vertices[i].clip_position.z;
-		  t = (w1 - z1) / ((w1 - z1) - (w2 - z2));
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
-	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		z1 = vertices[prev].clip_position.z;
-		w2 = vertices[0].clip_position.w;
-		z2 = vertices[0].clip_position.z;
-		t = (w1 - z1) / ((w1 - z1) - (w2 - z2));
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
-	  }
-	  num_vertex = in_vertices.size();
-	  break;
-	case ClipPlane::kTop: idot = vertices[0].clip_position.y < vertices[0].clip_position.w ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.y < vertices[i].clip_position.w ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  y1 = vertices[prev].clip_position.y;
-		  w2 = vertices[i].clip_position.w;
-		  y2 = vertices[i].clip_position.y;
-		  t = (w1 - y1) / ((w1 - y1) - (w2 - y2));
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
-	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		y1 = vertices[prev].clip_position.y;
-		w2 = vertices[0].clip_position.w;
-		y2 = vertices[0].clip_position.y;
-		t = (w1 - y1) / ((w1 - y1) - (w2 - y2));
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
-	  }
-	  num_vertex = in_vertices.size();
-	  break;
-	case ClipPlane::kBottom:
-	  idot = vertices[0].clip_position.y > -vertices[0].clip_position.w ? 1 : -1;
-	  for (int i = 0; i < num_vertex; i++) {
-		dot = vertices[i].clip_position.y > -vertices[i].clip_position.w ? 1 : -1;
-		// intersect with the plane
-		if (dot * pdot < 0) {
-		  w1 = vertices[prev].clip_position.w;
-		  y1 = vertices[prev].clip_position.y;
-		  w2 = vertices[i].clip_position.w;
-		  y2 = vertices[i].clip_position.y;
-		  t = (w1 + y1) / ((w1 + y1) - (w2 + y2));
-		  // lerp
-		  vertex = VertexOut::Lerp(vertices[prev], vertices[i], t);
-		  // add vertex to in_vertices
-		  in_vertices.push_back(vertex);
-		}
-		// current point is in
-		if (dot > 0) {
-		  in_vertices.push_back(vertices[i]);
-		}
-		// update index
-		prev = i;
-		pdot = dot;
+// the box is projected corner by corner, the nearest depth of a box in front
+// of the camera is at one of its corners
+ScreenBounds Pipeline::MeshScreenBounds(const Mesh *mesh, const Matrix4r &mvp) const {
+  ScreenBounds bounds;
+  bounds.valid = false;
+  AABB aabb = mesh->local_aabb();
+  Real x_min = 0, y_min = 0, x_max = 0, y_max = 0, min_depth = 0;
+  for (int i = 0; i < 8; i++) {
+	Vector4r corner(i & 1 ? aabb.max().x : aabb.min().x,
+					i & 2 ? aabb.max().y : aabb.min().y,
+					i & 4 ? aabb.max().z : aabb.min().z, 1.0);
+	Vector4r clip = mvp * corner;
+	if (clip.w <= 0) return bounds;
+	clip /= clip.w;
+	clip.w = 1.0;
+	clip.z = (clip.z + 1.0) * 0.5;
+	Vector4r pixel = viewport_matrix_ * clip;
+	x_min = i == 0 ? pixel.x : std::min(x_min, pixel.x);
+	y_min = i == 0 ? pixel.y : std::min(y_min, pixel.y);
+	x_max = i == 0 ? pixel.x : std::max(x_max, pixel.x);
+	y_max = i == 0 ? pixel.y : std::max(y_max, pixel.y);
+	min_depth = i == 0 ? pixel.z : std::min(min_depth, pixel.z);
+  }
+  bounds.valid = true;
+  bounds.x_min = floor(x_min);
+  bounds.y_min = floor(y_min);
+  bounds.x_max = ceil(x_max);
+  bounds.y_max = ceil(y_max);
+  bounds.min_depth = min_depth;
+  return bounds;
+}
+
+void Pipeline::DrawTile(RenderMode mode, const Tile &tile, TileStats &stats) {
+  const Real *depth_buffer = back_buffer_->depth_buffer();
+  // the depth buffer holds whatever was drawn since the last clear
+  if (hi_z_culling_)
+	hi_z_buffer_->Reset(depth_buffer, tile.x_min, tile.y_min, tile.x_max, tile.y_max);
+  DepthPass pass = DepthPass::kShade;
+  if (mode != RenderMode::kLine && depth_prepass_) {
+	// the nearest depth of every pixel is known before any fragment is shaded
+	DrawTilePass(mode, tile, DepthPass::kDepthOnly, stats);
+	pass = DepthPass::kShadeEqual;
+  }
+  DrawTilePass(mode, tile, pass, stats);
+  // pixels left at the cleared depth were never written
+  for (int y = tile.y_min; y <= tile.y_max; y++) {
+	const Real *row = depth_buffer + y * width_;
+	for (int x = tile.x_min; x <= tile.x_max; x++)
+	  stats.pixels_covered += row[x] < 1.0;
+  }
+}
+
+void Pipeline::DrawTilePass(RenderMode mode, const Tile &tile, DepthPass pass, TileStats &stats) {
+  bool fill = mode != RenderMode::kLine;
+  bool cull = fill && hi_z_culling_;
+  // triangles of a mesh are contiguous, its box is tested once per tile
+  int mesh_index = -1;
+  bool mesh_occluded = false;
+  Uniform uniform;
+  for (int i = 0; i < tile.triangles.size(); i++) {
+	const RasterTriangle &triangle = triangles_[tile.triangles[i]];
+	if (cull) {
+	  if (triangle.mesh != mesh_index) {
+		mesh_index = triangle.mesh;
+		mesh_occluded = TileOccluded(mesh_bounds_[mesh_index], tile);
 	  }
-	  // handle the last and the first
-	  if (pdot * idot < 0) {
-		w1 = vertices[prev].clip_position.w;
-		y1 = vertices[prev].clip_position.y;
-		w2 = vertices[0].clip_position.w;
-		y2 = vertices[0].clip_position.y;
-		t = (w1 + y1) / ((w1 + y1) - (w2 + y2));
-		// lerp
-		vertex = VertexOut::Lerp(vertices[prev], vertices[0], t);
-		// add vertex to in_vertices
-		in_vertices.push_back(vertex);
+	  if (mesh_occluded || TileOccluded(triangle.bounds, tile)) {
+		if (pass != DepthPass::kDepthOnly) stats.triangles_occluded++;
+		continue;
 	  }
-	  num_vertex = in_vertices.size();
-	  break;
+	}
+	Mesh *mesh = meshes_[triangle.mesh];
+	uniform.model_normal_matrix = &model_normal_matrices_[triangle.mesh];
+	uniform.TBN_matrix = &triangle.TBN_matrix;
+	uniform.albedo_texture = &mesh->albedo_texture;
+	uniform.normal_texture = &mesh->normal_texture;
+	if (fill) {
+	  DrawTriangle(triangle.v[0], triangle.v[1], triangle.v[2], uniform, tile, pass, stats);
+	} else {
+	  DrawLine(triangle.v[0], triangle.v[1], uniform, tile, stats);
+	  DrawLine(triangle.v[1], triangle.v[2], uniform, tile, stats);
+	  DrawLine(triangle.v[2], triangle.v[0], uniform, tile, stats);
+	}
+	if (cull && pass != DepthPass::kShadeEqual) {
+	  hi_z_buffer_->Write(triangle.bounds.min_depth,
+						  std::max(triangle.bounds.x_min, tile.x_min), std::max(triangle.bounds.y_min, tile.y_min),
+						  std::min(triangle.bounds.x_max, tile.x_max), std::min(triangle.bounds.y_max, tile.y_max));
+	}
   }
+}
 
-  return in_vertices;
+bool Pipeline::TileOccluded(const ScreenBounds &bounds, const Tile &tile) {
+  if (!bounds.valid) return false;
+  return hi_z_buffer_->Occluded(back_buffer_->depth_buffer(), bounds.min_depth,
+								std::max(bounds.x_min, tile.x_min), std::max(bounds.y_min, tile.y_min),
+								std::min(bounds.x_max, tile.x_max), std::min(bounds.y_max, tile.y_max));
 }
 
-void Pipeline::PerspectiveDivision(VertexOut &v) {
-  v.clip_position /= v.clip_position.w;
-  v.clip_position.w = 1.0;
-  // map [-1,1] to [0,1]
-  v.clip_position.z = (v.clip_position.z + 1.0) * 0.5;
+void Pipeline::ShadeFragment(int x, int y, const VertexOut &fragment, const Uniform &uniform,
+							 TileStats &stats) {
+  int64_t index = stats.fragments_shaded++;
+  bool sample = stage_timing_ && index % kFragmentTimingStride == 0;
+  Clock::time_point start;
+  if (sample) start = Clock::now();
+  if (deferred_) {
+	Vector4r normal, albedo;
+	shader_->SurfaceShader(fragment, uniform, normal, albedo);
+	gbuffer_->Write(x, y, fragment.world_position, normal, albedo);
+  } else {
+	back_buffer_->DrawPixel(x, y, shader_->FragmentShader(fragment, uniform));
+  }
+  if (sample) {
+	stats.sampled_ms += ElapsedMs(start);
+	stats.sampled++;
+  }
+}
+
+void Pipeline::LightTile(const Tile &tile) {
+  const Real *depth_buffer = back_buffer_->depth_buffer();
+  for (int y = tile.y_min; y <= tile.y_max; y++) {
+	for (int x = tile.x_min; x <= tile.x_max; x++) {
+	  if (depth_buffer[y * width_ + x] >= 1.0) continue;
+	  Vector4r color = shader_->LightingShader(gbuffer_->position(x, y), gbuffer_->normal(x, y),
+											   gbuffer_->albedo(x, y));
+	  back_buffer_->DrawPixel(x, y, color);
+	}
+  }
 }
 
-void Pipeline::DrawLine(const VertexOut &p1, const VertexOut &p2) {
+// only the pixels inside tile are written
+void Pipeline::DrawLine(const VertexOut &p1, const VertexOut &p2,
+						const Uniform &uniform, const Tile &tile, TileStats &stats) {
   int ix0 = static_cast<int>(floor(p1.pixel_position.x));
   int iy0 = static_cast<int>(floor(p1.pixel_position.y));
   int ix1 = static_cast<int>(floor(p2.pixel_position.x));
   int iy1 = static_cast<int>(floor(p2.pixel_position.y));
-  double z0 = p1.pixel_position.z;
-  double z1 = p2.pixel_position.z;
+  Real z0 = p1.pixel_position.z;
+  Real z1 = p2.pixel_position.z;
   int tmp = 1;           // 用于处理m小于0
   bool steep = false;    // 用于处理是否陡峭
   // 处理m绝对值大于1的情况
@@ -455,34 +407,40 @@ void Pipeline::DrawLine(const VertexOut &p1, const VertexOut &p2) {
 	tmp = -1;
   }
   // Bresenham算法
-  Vector4d color;
   VertexOut curr;
   int delta_x = ix1 - ix0, delta_y = iy1 - iy0;
-  double depth, t;
-  for (int x = ix0, y = iy0, eps = 0; x <= ix1; x++) {
-	if (steep) {
+  Real depth, t;
+  // x runs along the major axis, nothing after the tile's far side is drawn
+  int x_end = std::min(ix1, steep ? tile.y_max : tile.x_max);
+  for (int x = ix0, y = iy0, eps = 0; x <= x_end; x++) {
+	int px = steep ? y : x;
+	int py = steep ? x : y;
+	bool in_tile = px >= tile.x_min && px <= tile.x_max && py >= tile.y_min && py <= tile.y_max;
+	if (in_tile && steep) {
 	  // depth test
-	  t = static_cast<double>(x - ix0) / static_cast<double>(delta_x);
+	  t = static_cast<Real>(x - ix0) / static_cast<Real>(delta_x);
 	  depth = z0 * (1.0 - t) + z1 * t;
+	  stats.pixels_tested++;
 	  if (depth < back_buffer_->GetDepth(y, x)) {
+		stats.depth_passed++;
 		back_buffer_->SetDepth(y, x, depth);
 		// shading
 		curr.pixel_position.x = y;
 		curr.pixel_position.y = x;
-		color = shader_->FragmentShader(curr);
-		back_buffer_->DrawPixel(y, x, color);
+		ShadeFragment(y, x, curr, uniform, stats);
 	  }
-	} else {
+	} else if (in_tile) {
 	  // depth test
-	  t = static_cast<double>(x - ix0) / static_cast<double>(delta_x);
+	  t = static_cast<Real>(x - ix0) / static_cast<Real>(delta_x);
 	  depth = z0 * (1.0 - t) + z1 * t;
+	  stats.pixels_tested++;
 	  if (depth < back_buffer_->GetDepth(x, y)) {
+		stats.depth_passed++;
 		back_buffer_->SetDepth(x, y, depth);
 		// shading
 		curr.pixel_position.x = x;
 		curr.pixel_position.y = y;
-		color = shader_->FragmentShader(curr);
-		back_buffer_->DrawPixel(x, y, color);
+		ShadeFragment(x, y, curr, uniform, stats);
 	  }
 	}
 	if (2 * tmp * (eps + delta_y) < delta_x) {
@@ -494,49 +452,65 @@ void Pipeline::DrawLine(const VertexOut &p1, const VertexOut &p2) {
   }
 }
 
-void Pipeline::DrawTriangle(const VertexOut &p1, const VertexOut &p2, const VertexOut &p3) {
-  Vector3d a(p1.pixel_position.x, p1.pixel_position.y, p1.pixel_position.z);
-  Vector3d b(p2.pixel_position.x, p2.pixel_position.y, p2.pixel_position.z);
-  Vector3d c(p3.pixel_position.x, p3.pixel_position.y, p3.pixel_position.z);
+// only the pixels inside tile are rasterized
+void Pipeline::DrawTriangle(const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+							const Uniform &uniform, const Tile &tile, DepthPass pass, TileStats &stats) {
+  Vector3r a(p1.pixel_position.x, p1.pixel_position.y, p1.pixel_position.z);
+  Vector3r b(p2.pixel_position.x, p2.pixel_position.y, p2.pixel_position.z);
+  Vector3r c(p3.pixel_position.x, p3.pixel_position.y, p3.pixel_position.z);
 
   int x_min = floor(std::min(a.x, std::min(b.x, c.x)));
   int y_min = floor(std::min(a.y, std::min(b.y, c.y)));
   int x_max = ceil(std::max(a.x, std::max(b.x, c.x)));
   int y_max = ceil(std::max(a.y, std::max(b.y, c.y)));
+  x_min = std::max(x_min, tile.x_min);
+  y_min = std::max(y_min, tile.y_min);
+  x_max = std::min(x_max, tile.x_max);
+  y_max = std::min(y_max, tile.y_max);
+
+  if (simd_level_ != SimdLevel::kScalar) {
+	int tested = RasterizeTriangleSIMD(simd_level_, pass, p1, p2, p3, x_min, y_min, x_max, y_max,
+									   back_buffer_->depth_buffer(), width_,
+									   [this, &uniform, &stats](int x, int y, const VertexOut &fragment) {
+	  stats.depth_passed++;
+	  ShadeFragment(x, y, fragment, uniform, stats);
+	});
+	if (pass != DepthPass::kDepthOnly) stats.pixels_tested += tested;
+	return;
+  }
 
-  double alpha, beta, gamma, depth;
   VertexOut curr;
-  Vector4d color;
-  double w;
-
-  for (int y = y_min; y <= y_max; y++) {
-	for (int x = x_min; x <= x_max; x++) {
-	  if (InTriangle(Vector2d(x, y), a, b, c, alpha, beta, gamma)) {
-		// depth test
-		depth = alpha * a.z + beta * b.z + gamma * c.z;
-		if (depth > back_buffer_->GetDepth(x, y)) continue;
-		back_buffer_->SetDepth(x, y, depth);
-		// lerp
-		curr.world_position =
-			alpha * p1.world_position + beta * p2.world_position + gamma * p3.world_position;
-		curr.view_position =
-			alpha * p1.view_position + beta * p2.view_position + gamma * p3.view_position;
-		curr.normal = alpha * p1.normal + beta * p2.normal + gamma * p3.normal;
-		curr.texcoord = alpha * p1.texcoord + beta * p2.texcoord + gamma * p3.texcoord;
-		curr.one_div_z = alpha * p1.one_div_z + beta * p2.one_div_z + gamma * p3.one_div_z;
-		// restore
-		w = 1.0 / curr.one_div_z;
-		curr.world_position *= w;
-		curr.view_position *= w;
-		curr.texcoord *= w;
-		curr.color *= w;
-		curr.normal *= w;
-		// fragment shader
-		color = shader_->FragmentShader(curr);
-		back_buffer_->DrawPixel(x, y, color);
-	  }
-	}
-  }
+  Real w, depth;
+
+  RasterizeTriangle(a, b, c, x_min, y_min, x_max, y_max,
+					[&](int x, int y, Real alpha, Real beta, Real gamma) {
+	// depth test
+	depth = alpha * a.z + beta * b.z + gamma * c.z;
+	if (pass != DepthPass::kDepthOnly) stats.pixels_tested++;
+	if (pass == DepthPass::kShadeEqual ? depth != back_buffer_->GetDepth(x, y)
+									   : depth > back_buffer_->GetDepth(x, y))
+	  return;
+	if (pass != DepthPass::kShadeEqual) back_buffer_->SetDepth(x, y, depth);
+	if (pass == DepthPass::kDepthOnly) return;
+	stats.depth_passed++;
+	// lerp
+	curr.world_position =
+		alpha * p1.world_position + beta * p2.world_position + gamma * p3.world_position;
+	curr.view_position =
+		alpha * p1.view_position + beta * p2.view_position + gamma * p3.view_position;
+	curr.normal = alpha * p1.normal + beta * p2.normal + gamma * p3.normal;
+	curr.texcoord = alpha * p1.texcoord + beta * p2.texcoord + gamma * p3.texcoord;
+	curr.one_div_z = alpha * p1.one_div_z + beta * p2.one_div_z + gamma * p3.one_div_z;
+	// restore
+	w = 1.0 / curr.one_div_z;
+	curr.world_position *= w;
+	curr.view_position *= w;
+	curr.texcoord *= w;
+	curr.color *= w;
+	curr.normal *= w;
+	// fragment shader
+	ShadeFragment(x, y, curr, uniform, stats);
+  });
 }
 
 void Pipeline::DrawSkybox(RenderMode mode) {
@@ -559,71 +533,41 @@ void Pipeline::DrawSkybox(RenderMode mode) {
 void Pipeline::DrawSkyboxTriangle(const SkyBoxVertex &v1,
 								  const SkyBoxVertex &v2,
 								  const SkyBoxVertex &v3, int index) {
-  Vector3d a(v1.pos.x, v1.pos.y, v1.pos.z);
-  Vector3d b(v2.pos.x, v2.pos.y, v2.pos.z);
-  Vector3d c(v3.pos.x, v3.pos.y, v3.pos.z);
-
-  int x_min = floor(std::min(a.x, std::min(b.x, c.x)));
-  int y_min = floor(std::min(a.y, std::min(b.y, c.y)));
-  int x_max = ceil(std::max(a.x, std::max(b.x, c.x)));
-  int y_max = ceil(std::max(a.y, std::max(b.y, c.y)));
-
-  double alpha, beta, gamma, depth;
-  Vector4d color;
-
-  for (int y = y_min; y <= y_max; y++) {
-	for (int x = x_min; x <= x_max; x++) {
-	  if (InTriangle(Vector2d(x, y), a, b, c, alpha, beta, gamma)) {
-		if (back_buffer_->GetDepth(x, y) >= 1.0) {
-		  Vector2d uv = alpha * v1.tex + beta * v2.tex + gamma * v3.tex;
-		  switch (index) {
-		    case 0:
-		      color = skybox_->Sample(uv, Face::kFront);
-		      break;
-		    case 1:
-		      color = skybox_->Sample(uv, Face::kBack);
-			  break;
-		    case 2:
-		      color = skybox_->Sample(uv, Face::kLeft);
-			  break;
-		    case 3:
-		      color = skybox_->Sample(uv, Face::kRight);
-			  break;
-		    case 4:
-		      color = skybox_->Sample(uv, Face::kUp);
-			  break;
-		    case 5:
-		      color = skybox_->Sample(uv, Face::kDown);
-			  break;
-		  }
-		  back_buffer_->DrawPixel(x, y, color);
-		}
-	  }
+  Vector3r a(v1.pos.x, v1.pos.y, v1.pos.z);
+  Vector3r b(v2.pos.x, v2.pos.y, v2.pos.z);
+  Vector3r c(v3.pos.x, v3.pos.y, v3.pos.z);
+
+  int x_min = std::max(static_cast<int>(floor(std::min(a.x, std::min(b.x, c.x)))), 0);
+  int y_min = std::max(static_cast<int>(floor(std::min(a.y, std::min(b.y, c.y)))), 0);
+  int x_max = std::min(static_cast<int>(ceil(std::max(a.x, std::max(b.x, c.x)))), width_ - 1);
+  int y_max = std::min(static_cast<int>(ceil(std::max(a.y, std::max(b.y, c.y)))), height_ - 1);
+
+  Vector4r color;
+
+  RasterizeTriangle(a, b, c, x_min, y_min, x_max, y_max,
+					[&](int x, int y, Real alpha, Real beta, Real gamma) {
+	if (back_buffer_->GetDepth(x, y) < 1.0) return;
+	Vector2r uv = alpha * v1.tex + beta * v2.tex + gamma * v3.tex;
+	switch (index) {
+	  case 0:
+		color = skybox_->Sample(uv, Face::kFront);
+		break;
+	  case 1:
+		color = skybox_->Sample(uv, Face::kBack);
+		break;
+	  case 2:
+		color = skybox_->Sample(uv, Face::kLeft);
+		break;
+	  case 3:
+		color = skybox_->Sample(uv, Face::kRight);
+		break;
+	  case 4:
+		color = skybox_->Sample(uv, Face::kUp);
+		break;
+	  case 5:
+		color = skybox_->Sample(uv, Face::kDown);
+		break;
 	}
-  }
-}
-
-bool Pipeline::InTriangle(const Vector2d &p, const Vector3d &a,
-						  const Vector3d &b, const Vector3d &c, double &alpha,
-						  double &beta, double &gamma) {
-  double x_ba = b.x - a.x;
-  double x_ca = c.x - a.x;
-  double x_pa = p.x - a.x;
-  double y_ba = b.y - a.y;
-  double y_ca = c.y - a.y;
-  double y_pa = p.y - a.y;
-
-  double den = x_ba * y_ca - x_ca * y_ba;
-  double num_beta = x_pa * y_ca - x_ca * y_pa;
-  double num_gamma = x_ba * y_pa - x_pa * y_ba;
-
-  beta = num_beta / den;
-  gamma = num_gamma / den;
-  alpha = 1.0 - beta - gamma;
-
-  if (alpha >= 0 && beta >= 0 && gamma >= 0) {
-	return true;
-  } else {
-	return false;
-  }
+	back_buffer_->DrawPixel(x, y, color);
+  });
 }
\ No newline at end of file
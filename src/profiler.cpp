@@ -0,0 +1,96 @@
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct ProfileEvent {
+  const char *name;
+  int64_t start, end;
+};
+
+// Written only by its own thread. head counts every event ever recorded, the
+// newest kProfileRingSize of them are kept.
+struct ProfileRing {
+  ProfileEvent events[kProfileRingSize];
+  std::atomic<uint64_t> head;
+  int thread_id;
+};
+
+static std::mutex &RingsMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// rings live until the process exits, so a dump still sees threads that are gone
+static std::vector<std::unique_ptr<ProfileRing>> &Rings() {
+  static std::vector<std::unique_ptr<ProfileRing>> rings;
+  return rings;
+}
+
+static ProfileRing *ThreadRing() {
+  thread_local ProfileRing *ring = nullptr;
+  if (!ring) {
+	std::lock_guard<std::mutex> lock(RingsMutex());
+	Rings().emplace_back(new ProfileRing());
+	ring = Rings().back().get();
+	ring->head = 0;
+	ring->thread_id = static_cast<int>(Rings().size()) - 1;
+  }
+  return ring;
+}
+
+int64_t Profiler::Now() {
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::Record(const char *name, int64_t start, int64_t end) {
+  ProfileRing *ring = ThreadRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ProfileEvent &event = ring->events[head % kProfileRingSize];
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  // publish the event to WriteChromeTrace
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::WriteChromeTrace(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (!fp) {
+	printf("Failed to open %s.\n", path.c_str());
+	return false;
+  }
+  std::lock_guard<std::mutex> lock(RingsMutex());
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  bool first = true;
+  for (int i = 0; i < Rings().size(); i++) {
+	const ProfileRing &ring = *Rings()[i];
+	fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+				"\"args\": {\"name\": \"thread %d\"}}",
+			first ? "" : ",\n", ring.thread_id, ring.thread_id);
+	first = false;
+	uint64_t head = ring.head.load(std::memory_order_acquire);
+	uint64_t begin = head > kProfileRingSize ? head - kProfileRingSize : 0;
+	for (uint64_t j = begin; j < head; j++) {
+	  const ProfileEvent &event = ring.events[j % kProfileRingSize];
+	  // complete events, timestamps in microseconds
+	  fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+			  event.name, ring.thread_id, event.start / 1000.0, (event.end - event.start) / 1000.0);
+	}
+  }
+  fprintf(fp, "\n]}\n");
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+void Profiler::Clear() {
+  std::lock_guard<std::mutex> lock(RingsMutex());
+  for (int i = 0; i < Rings().size(); i++)
+	Rings()[i]->head.store(0, std::memory_order_relaxed);
+}
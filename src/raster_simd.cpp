@@ -0,0 +1,203 @@
+#include "raster_simd.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SOFTRENDERER_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#ifdef SOFTRENDERER_SIMD_X86
+
+// intrinsics for the lanes of Real, 2 or 4 per SSE register and 4 or 8 per AVX register
+#ifdef SOFTRENDERER_USE_FLOAT
+typedef __m128 SseReg;
+typedef __m256 AvxReg;
+#define SSE(op) _mm_##op##_ps
+#define AVX(op) _mm256_##op##_ps
+#else
+typedef __m128d SseReg;
+typedef __m256d AvxReg;
+#define SSE(op) _mm_##op##_pd
+#define AVX(op) _mm256_##op##_pd
+#endif
+const int kSseLanes = sizeof(SseReg) / sizeof(Real);
+const int kAvxLanes = sizeof(AvxReg) / sizeof(Real);
+
+static const Real kLaneIndex[kRasterBlockSize] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+// The kernels below use separate multiplies and adds in the same order as the
+// scalar code, so no lane ever differs from what DrawTriangle would compute.
+// They only do arithmetic and return, shading happens in non-AVX code so the
+// shader never runs with dirty upper register halves.
+
+template <DepthPass pass>
+__attribute__((target("avx2")))
+static int RowAVX2(const TriangleSetup &setup, const TriangleAttributes &attr,
+				   int nx, Real w0_row, Real w1_row, Real w2_row,
+				   bool inside, const Real *depth_row, int &covered,
+				   Real depth[kRasterBlockSize], Real out[TriangleAttributes::kNumAttributes][kRasterBlockSize]) {
+  const AvxReg zero = AVX(setzero)();
+  const AvxReg one_div_area = AVX(set1)(setup.one_div_area);
+  int bits = 0;
+  covered = 0;
+
+  for (int h = 0; h < nx; h += kAvxLanes) {
+	AvxReg w0 = AVX(add)(AVX(set1)(w0_row), AVX(loadu)(setup.offset0 + h));
+	AvxReg w1 = AVX(add)(AVX(set1)(w1_row), AVX(loadu)(setup.offset1 + h));
+	AvxReg w2 = AVX(add)(AVX(set1)(w2_row), AVX(loadu)(setup.offset2 + h));
+	// coverage
+	AvxReg mask = AVX(cmp)(AVX(loadu)(kLaneIndex + h), AVX(set1)(nx), _CMP_LT_OQ);
+	if (!inside) {
+	  mask = AVX(and)(mask, AVX(cmp)(w0, zero, _CMP_GE_OQ));
+	  mask = AVX(and)(mask, AVX(cmp)(w1, zero, _CMP_GE_OQ));
+	  mask = AVX(and)(mask, AVX(cmp)(w2, zero, _CMP_GE_OQ));
+	}
+	int cover_bits = AVX(movemask)(mask);
+	if (cover_bits == 0) continue;
+	covered |= cover_bits << h;
+	// depth test
+	AvxReg alpha = AVX(mul)(w0, one_div_area);
+	AvxReg beta = AVX(mul)(w1, one_div_area);
+	AvxReg gamma = AVX(mul)(w2, one_div_area);
+	AvxReg z = AVX(add)(
+		AVX(add)(AVX(mul)(alpha, AVX(set1)(attr.z[0])), AVX(mul)(beta, AVX(set1)(attr.z[1]))),
+		AVX(mul)(gamma, AVX(set1)(attr.z[2])));
+	for (int l = h; l < h + kAvxLanes; l++)
+	  depth[l] = l < nx ? depth_row[l] : 0;
+	mask = AVX(and)(mask, AVX(cmp)(z, AVX(loadu)(depth + h),
+								   pass == DepthPass::kShadeEqual ? _CMP_EQ_OQ : _CMP_NGT_UQ));
+	int lane_bits = AVX(movemask)(mask);
+	if (lane_bits == 0) continue;
+	bits |= lane_bits << h;
+	AVX(storeu)(depth + h, z);
+	if (pass == DepthPass::kDepthOnly) continue;
+	// lerp and restore, one_div_z is the last attribute so w is ready before the others
+	AvxReg w = AVX(setzero)();
+	for (int i = TriangleAttributes::kNumAttributes - 1; i >= 0; i--) {
+	  AvxReg v = AVX(add)(
+		  AVX(add)(AVX(mul)(alpha, AVX(set1)(attr.value[i][0])),
+				   AVX(mul)(beta, AVX(set1)(attr.value[i][1]))),
+		  AVX(mul)(gamma, AVX(set1)(attr.value[i][2])));
+	  if (i == TriangleAttributes::kOneDivZ) {
+		w = AVX(div)(AVX(set1)(1), v);
+	  } else {
+		v = AVX(mul)(v, w);
+	  }
+	  AVX(storeu)(out[i] + h, v);
+	}
+  }
+  return bits;
+}
+
+// SSE2 is part of x86-64, so this needs no target attribute
+template <DepthPass pass>
+static int RowSSE2(const TriangleSetup &setup, const TriangleAttributes &attr,
+				   int nx, Real w0_row, Real w1_row, Real w2_row,
+				   bool inside, const Real *depth_row, int &covered,
+				   Real depth[kRasterBlockSize], Real out[TriangleAttributes::kNumAttributes][kRasterBlockSize]) {
+  const SseReg zero = SSE(setzero)();
+  const SseReg one_div_area = SSE(set1)(setup.one_div_area);
+  int bits = 0;
+  covered = 0;
+
+  for (int h = 0; h < nx; h += kSseLanes) {
+	SseReg w0 = SSE(add)(SSE(set1)(w0_row), SSE(loadu)(setup.offset0 + h));
+	SseReg w1 = SSE(add)(SSE(set1)(w1_row), SSE(loadu)(setup.offset1 + h));
+	SseReg w2 = SSE(add)(SSE(set1)(w2_row), SSE(loadu)(setup.offset2 + h));
+	// coverage
+	SseReg mask = SSE(cmplt)(SSE(loadu)(kLaneIndex + h), SSE(set1)(nx));
+	if (!inside) {
+	  mask = SSE(and)(mask, SSE(cmpge)(w0, zero));
+	  mask = SSE(and)(mask, SSE(cmpge)(w1, zero));
+	  mask = SSE(and)(mask, SSE(cmpge)(w2, zero));
+	}
+	int cover_bits = SSE(movemask)(mask);
+	if (cover_bits == 0) continue;
+	covered |= cover_bits << h;
+	// depth test
+	SseReg alpha = SSE(mul)(w0, one_div_area);
+	SseReg beta = SSE(mul)(w1, one_div_area);
+	SseReg gamma = SSE(mul)(w2, one_div_area);
+	SseReg z = SSE(add)(
+		SSE(add)(SSE(mul)(alpha, SSE(set1)(attr.z[0])), SSE(mul)(beta, SSE(set1)(attr.z[1]))),
+		SSE(mul)(gamma, SSE(set1)(attr.z[2])));
+	for (int l = h; l < h + kSseLanes; l++)
+	  depth[l] = l < nx ? depth_row[l] : 0;
+	if (pass == DepthPass::kShadeEqual)
+	  mask = SSE(and)(mask, SSE(cmpeq)(z, SSE(loadu)(depth + h)));
+	else
+	  mask = SSE(and)(mask, SSE(cmpngt)(z, SSE(loadu)(depth + h)));
+	int lane_bits = SSE(movemask)(mask);
+	if (lane_bits == 0) continue;
+	bits |= lane_bits << h;
+	SSE(storeu)(depth + h, z);
+	if (pass == DepthPass::kDepthOnly) continue;
+	// lerp and restore, one_div_z is the last attribute so w is ready before the others
+	SseReg w = SSE(setzero)();
+	for (int i = TriangleAttributes::kNumAttributes - 1; i >= 0; i--) {
+	  SseReg v = SSE(add)(
+		  SSE(add)(SSE(mul)(alpha, SSE(set1)(attr.value[i][0])),
+				   SSE(mul)(beta, SSE(set1)(attr.value[i][1]))),
+		  SSE(mul)(gamma, SSE(set1)(attr.value[i][2])));
+	  if (i == TriangleAttributes::kOneDivZ) {
+		w = SSE(div)(SSE(set1)(1), v);
+	  } else {
+		v = SSE(mul)(v, w);
+	  }
+	  SSE(storeu)(out[i] + h, v);
+	}
+  }
+  return bits;
+}
+
+#undef SSE
+#undef AVX
+
+#endif
+
+SimdLevel DetectSimdLevel() {
+#ifdef SOFTRENDERER_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+	return SimdLevel::kAVX2;
+  if (__builtin_cpu_supports("sse2"))
+	return SimdLevel::kSSE2;
+#endif
+  return SimdLevel::kScalar;
+}
+
+// the kernel of one instruction set and depth pass
+template <DepthPass pass>
+static RowKernel SelectKernel(SimdLevel level) {
+  return level == SimdLevel::kAVX2 ? RowAVX2<pass> : RowSSE2<pass>;
+}
+
+bool SetupTriangleSIMD(SimdLevel level, DepthPass pass,
+					   const VertexOut &p1, const VertexOut &p2, const VertexOut &p3,
+					   int x_min, int y_min, int x_max, int y_max,
+					   SimdTriangle &triangle) {
+#ifdef SOFTRENDERER_SIMD_X86
+  Vector3r a(p1.pixel_position.x, p1.pixel_position.y, p1.pixel_position.z);
+  Vector3r b(p2.pixel_position.x, p2.pixel_position.y, p2.pixel_position.z);
+  Vector3r c(p3.pixel_position.x, p3.pixel_position.y, p3.pixel_position.z);
+
+  if (!triangle.setup.Setup(a, b, c, x_min, y_min, x_max, y_max)) return false;
+  triangle.attr.Setup(0, p1);
+  triangle.attr.Setup(1, p2);
+  triangle.attr.Setup(2, p3);
+
+  switch (pass) {
+	case DepthPass::kShade:
+	  triangle.kernel = SelectKernel<DepthPass::kShade>(level);
+	  break;
+	case DepthPass::kDepthOnly:
+	  triangle.kernel = SelectKernel<DepthPass::kDepthOnly>(level);
+	  break;
+	default:
+	  triangle.kernel = SelectKernel<DepthPass::kShadeEqual>(level);
+	  break;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
@@ -3,14 +3,13 @@
 #include <fstream>
 #include <sstream>
 
-void Scene::LoadScene() {
-  camera_ = new Camera(Vector3d(0, 0, 0), Vector3d(0, 0, 1), Vector3d(0, 1, 0));
+void Scene::LoadScene(const std::string &base_path) {
+  camera_ = new Camera(Vector3r(0, 0, 0), Vector3r(0, 0, 1), Vector3r(0, 1, 0));
   Mesh *mesh;
-  Matrix4d model, m_pos, m_rot, m_sca;
+  Matrix4r model, m_pos, m_rot, m_sca;
   Light *light;
   std::ifstream ifs;
   std::string line, key, x, y, z, w, count, skybox_name;
-  std::string base_path = "../assets/scene0/";
 
   ifs.open(base_path + "scene0_config.txt");
   if (ifs.fail()) {
@@ -46,17 +45,17 @@ void Scene::LoadScene() {
 		std::getline(ifs, line);
 		std::istringstream pos(line);
 		pos >> key >> x >> y >> z;
-		m_pos.SetTranslation(Vector3d(std::stod(x), std::stod(y), std::stod(z)));
+		m_pos.SetTranslation(Vector3r(std::stod(x), std::stod(y), std::stod(z)));
 		// read rot
 		std::getline(ifs, line);
 		std::istringstream rot(line);
 		rot >> key >> x >> y >> z >> w;
-		m_rot.SetRotationAxis(std::stod(w), Vector3d(std::stod(x), std::stod(y), std::stod(z)));
+		m_rot.SetRotationAxis(std::stod(w), Vector3r(std::stod(x), std::stod(y), std::stod(z)));
 		// read sca
 		std::getline(ifs, line);
 		std::istringstream sca(line);
 		sca >> key >> x >> y >> z;
-		m_sca.SetScale(Vector3d(std::stod(x), std::stod(y), std::stod(z)));
+		m_sca.SetScale(Vector3r(std::stod(x), std::stod(y), std::stod(z)));
 		// set model matrix
 		model = m_pos * m_rot * m_sca;
 		mesh->set_model_matrix(model);
@@ -77,25 +76,37 @@ void Scene::LoadScene() {
 		  std::getline(ifs, line);
 		  std::istringstream dir(line);
 		  dir >> key >> x >> y >> z;
-		  light = new DirectionLight(Vector4d(std::stod(x), std::stod(y), std::stod(z), 0.0));
+		  light = new DirectionLight(Vector4r(std::stod(x), std::stod(y), std::stod(z), 0.0));
 		} else if (x == "pl") {
 		  // point light
 		  std::getline(ifs, line);
 		  std::istringstream pos(line);
 		  pos >> key >> x >> y >> z;
-		  light = new PointLight(Vector4d(std::stod(x), std::stod(y), std::stod(z)));
+		  light = new PointLight(Vector4r(std::stod(x), std::stod(y), std::stod(z)));
 		} else if (x == "sl") {
 		  // spot light
 		  std::getline(ifs, line);
 		  std::istringstream pos(line);
 		  pos >> key >> x >> y >> z;
-		  Vector4d v_pos(std::stod(x), std::stod(y), std::stod(z));
+		  Vector4r v_pos(std::stod(x), std::stod(y), std::stod(z));
 		  std::getline(ifs, line);
 		  std::istringstream dir(line);
 		  dir >> key >> x >> y >> z;
-		  Vector4d v_dir(std::stod(x), std::stod(y), std::stod(z), 0.0);
+		  Vector4r v_dir(std::stod(x), std::stod(y), std::stod(z), 0.0);
 		  light = new SpotLight(v_pos, v_dir);
 		}
+		// optional shadow map size and depth bits after the light type, "l01 dl 1024 1024 16"
+		int shadow_width, shadow_height, shadow_bits;
+		if (light_data >> shadow_width >> shadow_height) {
+		  light->shadow_resolution(shadow_width, shadow_height);
+		  if (light_data >> shadow_bits) {
+			if (shadow_bits != 16 && shadow_bits != 32) {
+			  printf("scene config file is wrong.\n");
+			  exit(1);
+			}
+			light->shadow_format(shadow_bits == 16 ? ShadowFormat::kDepth16 : ShadowFormat::kDepth32);
+		  }
+		}
 		// add light to the scene
 		lights_.push_back(light);
       }
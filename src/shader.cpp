@@ -1,5 +1,7 @@
 #include "shader.h"
 
+#include "profiler.h"
+
 VertexOut Shader::VertexShader(const VertexIn &in) {
   VertexOut out;
   out.world_position = (*model_matrix_) * in.local_position;
@@ -21,14 +23,14 @@ void Shader::PerspectiveCorrection(VertexOut &in) {
 }
 
 void Shader::TBN_matrix(const VertexIn &a, const VertexIn &b, const VertexIn &c) {
-  Vector3d ab = b.local_position - a.local_position;
-  Vector3d ac = c.local_position - a.local_position;
-  Vector3d N = ab.Cross(ac).Normalize(), T, B;
-  double delta_u1 = b.texcoord.x - a.texcoord.x;
-  double delta_u2 = c.texcoord.x - a.texcoord.x;
-  double delta_v1 = b.texcoord.y - a.texcoord.y;
-  double delta_v2 = c.texcoord.y - a.texcoord.y;
-  double denom = 1.0 / (delta_u1 * delta_v2 - delta_u2 * delta_v1);
+  Vector3r ab = b.local_position - a.local_position;
+  Vector3r ac = c.local_position - a.local_position;
+  Vector3r N = ab.Cross(ac).Normalize(), T, B;
+  Real delta_u1 = b.texcoord.x - a.texcoord.x;
+  Real delta_u2 = c.texcoord.x - a.texcoord.x;
+  Real delta_v1 = b.texcoord.y - a.texcoord.y;
+  Real delta_v2 = c.texcoord.y - a.texcoord.y;
+  Real denom = 1.0 / (delta_u1 * delta_v2 - delta_u2 * delta_v1);
   // construct T and B axis
   T.x = denom * (delta_v2 * ab.x - delta_v1 * ac.x);
   T.y = denom * (delta_v2 * ab.y - delta_v1 * ac.y);
@@ -48,42 +50,76 @@ void Shader::set_model_normal_matrix() {
   model_normal_matrix_ = (*model_matrix_).AdjointMatrix33().Transpose33();
 }
 
-Vector4d PhongShader::FragmentShader(const VertexOut &in) {
-  Vector4d color;
-  // Vector4d normal = (model_normal_matrix_ * in.normal).Normalize();
-  Vector4d normal = normal_texture_->Sample(in.texcoord);
+void Shader::SurfaceShader(const VertexOut &in, const Uniform &uniform,
+						   Vector4r &normal, Vector4r &albedo) {
+  normal = (*uniform.model_normal_matrix * in.normal).Normalize();
+  albedo = uniform.albedo_texture->Sample(in.texcoord);
+}
+
+Vector4r Shader::LightingShader(const Vector4r &position, const Vector4r &normal,
+								const Vector4r &albedo) {
+  return albedo;
+}
+
+Vector4r PhongShader::FragmentShader(const VertexOut &in, const Uniform &uniform) {
+  PROFILE_FRAGMENT_ZONE("PhongShader::FragmentShader");
+  Vector4r normal, albedo;
+  PhongShader::SurfaceShader(in, uniform, normal, albedo);
+  return PhongShader::LightingShader(in.world_position, normal, albedo);
+}
+
+void PhongShader::SurfaceShader(const VertexOut &in, const Uniform &uniform,
+								Vector4r &normal, Vector4r &albedo) {
+  // Vector4r normal = (*uniform.model_normal_matrix * in.normal).Normalize();
+  normal = uniform.normal_texture->Sample(in.texcoord);
   normal /= 255.0;
-  normal = 2.0 * normal - Vector4d(1.0, 1.0, 1.0, 0.0);
-  normal = (model_normal_matrix_ * TBN_matrix_ * normal).Normalize();
+  normal = 2.0 * normal - Vector4r(1.0, 1.0, 1.0, 0.0);
+  normal = (*uniform.model_normal_matrix * *uniform.TBN_matrix * normal).Normalize();
+  albedo = uniform.albedo_texture->Sample(in.texcoord);
+}
 
-  Vector4d view_pos = *view_pos_;
-  Vector4d tex_color = albedo_texture_->Sample(in.texcoord);
-  Vector4d light_pixel_pos;
-  double depth;
+Vector4r PhongShader::LightingShader(const Vector4r &position, const Vector4r &normal,
+									 const Vector4r &albedo) {
+  Vector4r color;
+  Vector4r view_pos = *view_pos_;
+  Vector4r light_pixel_pos;
+  Real depth;
   for (int i = 0; i < lights_.size(); i++) {
-	light_pixel_pos = (*viewport_matrix_) * lights_[i]->project_matrix() * lights_[i]->view_matrix()
-		* in.world_position;
+	light_pixel_pos = lights_[i]->shadow_matrix() * position;
 	depth = (light_pixel_pos.z + 1.0) * 0.5;
 	if (depth + 0.1 < lights_[i]->shadow_buffer()->GetDepth(light_pixel_pos.x, light_pixel_pos.y))
-	  color += lights_[i]->Lighting(normal, in.world_position, view_pos, tex_color, true);
+	  color += lights_[i]->Lighting(normal, position, view_pos, albedo, true);
 	else
-	  color += lights_[i]->Lighting(normal, in.world_position, view_pos, tex_color, false);
+	  color += lights_[i]->Lighting(normal, position, view_pos, albedo, false);
   }
   Clamp(color, 0.0, 255.0);
 
   return color;
 }
 
-Vector4d LineShader::FragmentShader(const VertexOut &in) {
-  return Vector4d(255.0, 255.0, 255.0, 1.0);
+Vector4r LineShader::FragmentShader(const VertexOut &in, const Uniform &uniform) {
+  PROFILE_FRAGMENT_ZONE("LineShader::FragmentShader");
+  return Vector4r(255.0, 255.0, 255.0, 1.0);
+}
+
+Vector4r PBRShader::FragmentShader(const VertexOut &in, const Uniform &uniform) {
+  PROFILE_FRAGMENT_ZONE("PBRShader::FragmentShader");
+  Vector4r normal, albedo;
+  PBRShader::SurfaceShader(in, uniform, normal, albedo);
+  return PBRShader::LightingShader(in.world_position, normal, albedo);
+}
+
+void PBRShader::SurfaceShader(const VertexOut &in, const Uniform &uniform,
+							  Vector4r &normal, Vector4r &albedo) {
+  normal = (*uniform.model_normal_matrix * in.normal).Normalize();
+  albedo = uniform.albedo_texture->Sample(in.texcoord);
 }
 
-Vector4d PBRShader::FragmentShader(const VertexOut &in) {
-  Vector4d color;
-  Vector4d normal = (model_normal_matrix_ * in.normal).Normalize();
-  Vector4d tex_color = albedo_texture_->Sample(in.texcoord);
+Vector4r PBRShader::LightingShader(const Vector4r &position, const Vector4r &normal,
+								   const Vector4r &albedo) {
+  Vector4r color;
   for (int i = 0; i < lights_.size(); i++) {
-	  color += lights_[i]->PBRLighting(normal, in.world_position, *view_pos_, tex_color, false);
+	  color += lights_[i]->PBRLighting(normal, position, *view_pos_, albedo, false);
   }
   Clamp(color, 0.0, 255.0);
 
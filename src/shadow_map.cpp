@@ -1,90 +1,271 @@
 #include "shadow_map.h"
-#include "pipeline.h"
+
+#include <cstdio>
+
+#include "clipping.h"
+#include "path_pattern.h"
+#include "profiler.h"
+#include "rasterizer.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-void ShadowMap::RenderShadowMap(const Matrix4d &viewport_matrix) {
-  SetLights();
+ShadowMap::~ShadowMap() {
+  if (export_thread_.joinable()) export_thread_.join();
+  for (int i = 0; i < passes_.size(); i++)
+	if (passes_[i]) delete passes_[i];
+}
+
+static bool SameDirection(const Vector4r &a, const Vector4r &b) {
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static bool Overlaps(const ShadowRect &rect, const Tile &tile) {
+  return rect.x_min <= rect.x_max && rect.x_min <= tile.x_max && rect.x_max >= tile.x_min
+	  && rect.y_min <= tile.y_max && rect.y_max >= tile.y_min;
+}
+
+void ShadowMap::RenderShadowMap() {
+  PROFILE_ZONE("ShadowMap::RenderShadowMap");
+  // meshes whose model matrix changed since the last render, added meshes redraw everything
+  bool meshes_added = mesh_matrices_.size() != meshes_.size();
+  bool any_moved = false;
+  mesh_moved_.assign(meshes_.size(), 0);
+  mesh_matrices_.resize(meshes_.size());
+  for (int i = 0; i < meshes_.size(); i++) {
+	if (meshes_added || meshes_[i]->model_matrix != mesh_matrices_[i]) {
+	  mesh_moved_[i] = 1;
+	  any_moved = true;
+	  mesh_matrices_[i] = meshes_[i]->model_matrix;
+	}
+  }
+  if (meshes_added) {
+	vertex_offsets_.resize(meshes_.size() + 1);
+	vertex_offsets_[0] = 0;
+	for (int i = 0; i < meshes_.size(); i++)
+	  vertex_offsets_[i + 1] = vertex_offsets_[i] + meshes_[i]->vertices.size();
+  }
+
+  // decide what each light redraws and split the vertices to transform into batches
+  passes_.resize(lights_.size(), nullptr);
+  vertex_batches_.clear();
+  bin_jobs_.clear();
+  bool any_update = false;
   for (int k = 0; k < lights_.size(); k++) {
-	if (lights_[k]->type() == LightType::kDir) {
-	  for (int i = 0; i < meshes_.size(); i++) {
-		for (int j = 0; j < meshes_[i]->indices.size(); j += 3) {
-		  VertexIn p1, p2, p3;
-		  p1 = meshes_[i]->vertices[meshes_[i]->indices[j]];
-		  p2 = meshes_[i]->vertices[meshes_[i]->indices[j + 1]];
-		  p3 = meshes_[i]->vertices[meshes_[i]->indices[j + 2]];
-
-		  VertexOut v1, v2, v3;
-		  v1 = TransformVertex(p1, meshes_[i]->model_matrix, lights_[k]);
-		  v2 = TransformVertex(p2, meshes_[i]->model_matrix, lights_[k]);
-		  v3 = TransformVertex(p3, meshes_[i]->model_matrix, lights_[k]);
-
-		  v1.pixel_position = viewport_matrix * v1.clip_position;
-		  v2.pixel_position = viewport_matrix * v2.clip_position;
-		  v3.pixel_position = viewport_matrix * v3.clip_position;
-
-		  SetShadowTexture(v1, v2, v3, lights_[k]);
-		}
+	if (lights_[k]->type() != LightType::kDir) continue;
+	Light *light = lights_[k];
+	ShadowBuffer *shadow_buffer = light->shadow_buffer();
+	// the light's shadow buffer may have been reallocated at another size
+	if (passes_[k] && (passes_[k]->tile_grid.width() != shadow_buffer->width()
+		|| passes_[k]->tile_grid.height() != shadow_buffer->height())) {
+	  delete passes_[k];
+	  passes_[k] = nullptr;
+	}
+	if (!passes_[k]) passes_[k] = new ShadowPass(shadow_buffer->width(), shadow_buffer->height());
+	ShadowPass *pass = passes_[k];
+	pass->full = invalidated_ || meshes_added || !pass->rendered
+		|| pass->shadow_generation != light->shadow_generation()
+		|| !SameDirection(pass->light_dir, light->light_dir());
+	pass->update = false;
+	if (!pass->full && !any_moved) continue;
+	if (pass->mesh_passes.size() != meshes_.size()) {
+	  pass->mesh_passes.clear();
+	  for (int i = 0; i < meshes_.size(); i++)
+		pass->mesh_passes.emplace_back(shadow_buffer->width(), shadow_buffer->height());
+	}
+
+	// refit the projection, only the bounds of moved meshes are measured again
+	Vector3r dir = Vector3r(light->light_dir().x, light->light_dir().y, light->light_dir().z);
+	light->view_matrix(Vector3r(0.0, 0.0, 0.0), dir.Normalize(), Vector3r(0.0, 1.0, 0.0));
+	AABB bounds;
+	for (int i = 0; i < meshes_.size(); i++) {
+	  if (pass->full || mesh_moved_[i])
+		pass->mesh_passes[i].view_bounds = light->ViewBounds(meshes_[i]);
+	  bounds = AABB::Union(bounds, pass->mesh_passes[i].view_bounds);
+	}
+	light->project_matrix(bounds);
+	light->shadow_matrix(pass->viewport_matrix);
+	// once the fit changes every texel moves
+	if (light->shadow_matrix() != pass->shadow_matrix) pass->full = true;
+	pass->rendered = true;
+	pass->light_dir = light->light_dir();
+	pass->shadow_matrix = light->shadow_matrix();
+	pass->shadow_generation = light->shadow_generation();
+
+	// the meshes to transform and rebin, all of them or the moved ones
+	pass->dirty_tiles.assign(pass->tile_grid.num_tiles(), pass->full ? 1 : 0);
+	pass->positions.resize(vertex_offsets_.back());
+	Matrix4r light_matrix = light->project_matrix() * light->view_matrix();
+	int first_job = bin_jobs_.size(), first_batch = vertex_batches_.size();
+	bool touched = pass->full;
+	for (int i = 0; i < meshes_.size(); i++) {
+	  if (!pass->full && !mesh_moved_[i]) continue;
+	  ShadowMeshPass &mesh_pass = pass->mesh_passes[i];
+	  // where a moved mesh was is redrawn too
+	  if (!pass->full && mesh_pass.rect.x_min <= mesh_pass.rect.x_max) {
+		MarkTiles(pass, mesh_pass.rect);
+		touched = true;
 	  }
+	  mesh_pass.rect = ShadowRect{0, 0, -1, -1};
+	  mesh_pass.triangles.clear();
+	  mesh_pass.tile_grid.Clear();
+	  // shadow triangles are not clipped in depth, only meshes beside the light's view are skipped
+	  if (BoxOutsideFrustum(meshes_[i]->local_aabb(), light_matrix * meshes_[i]->model_matrix,
+							kSideClipPlanes))
+		continue;
+	  touched = true;
+	  bin_jobs_.push_back({k, i});
+	  int num_vertices = meshes_[i]->vertices.size();
+	  for (int begin = 0; begin < num_vertices; begin += kShadowVertexBatchSize)
+		vertex_batches_.push_back({k, i, begin, std::min(num_vertices, begin + kShadowVertexBatchSize)});
 	}
-	sprintf_s(name_, "shadow_map%d.png", k);
-	stbi_write_png(name_,
-				   lights_[k]->shadow_buffer()->width(),
-				   lights_[k]->shadow_buffer()->height(),
-				   3,
-				   lights_[k]->shadow_buffer()->shadow_texture(),
-				   3 * lights_[k]->shadow_buffer()->width());
+	// the moved meshes stay out of this light's view
+	if (!touched) {
+	  bin_jobs_.resize(first_job);
+	  vertex_batches_.resize(first_batch);
+	  continue;
+	}
+	pass->update = true;
+	any_update = true;
   }
+  invalidated_ = false;
+  if (!any_update) return;
+
+  thread_pool_->ParallelFor(vertex_batches_.size(), [this](int b) {
+	PROFILE_ZONE("Shadow vertex batch");
+	const VertexBatch &batch = vertex_batches_[b];
+	const Mesh *mesh = meshes_[batch.mesh];
+	ShadowPass *pass = passes_[batch.light];
+	Vector3r *positions = pass->positions.data() + vertex_offsets_[batch.mesh];
+	for (int v = batch.begin; v < batch.end; v++)
+	  positions[v] = TransformVertex(mesh->vertices[v], mesh->model_matrix, lights_[batch.light],
+									 pass->viewport_matrix);
+  });
+
+  // every (light, mesh) pair is binned into its own grid
+  thread_pool_->ParallelFor(bin_jobs_.size(), [this](int j) {
+	BinMesh(passes_[bin_jobs_[j].light], bin_jobs_[j].mesh);
+  });
+  // and where the moved meshes are now
+  for (int j = 0; j < bin_jobs_.size(); j++) {
+	ShadowPass *pass = passes_[bin_jobs_[j].light];
+	if (!pass->full) MarkTiles(pass, pass->mesh_passes[bin_jobs_[j].mesh].rect);
+  }
+
+  // one job per dirty tile of every light, tiles cover disjoint pixels of one shadow map
+  tile_jobs_.clear();
+  for (int k = 0; k < passes_.size(); k++) {
+	if (!passes_[k] || !passes_[k]->update) continue;
+	for (int t = 0; t < passes_[k]->tile_grid.num_tiles(); t++) {
+	  if (passes_[k]->dirty_tiles[t])
+		tile_jobs_.push_back({k, t});
+	}
+  }
+  thread_pool_->ParallelFor(tile_jobs_.size(), [this](int j) {
+	PROFILE_ZONE("Shadow tile");
+	const ShadowPass &pass = *passes_[tile_jobs_[j].light];
+	DrawTile(pass, tile_jobs_[j].tile, lights_[tile_jobs_[j].light]->shadow_buffer());
+  });
 }
 
-void ShadowMap::SetLights() {
-  for (int i = 0; i < lights_.size(); i++) {
-	if (lights_[i]->type() == LightType::kDir) {
-	  Vector3d pos = Vector3d(0.0, 0.0, 0.0);
-	  Vector3d dir =
-		  Vector3d(lights_[i]->light_dir().x, lights_[i]->light_dir().y, lights_[i]->light_dir().z);
-	  lights_[i]->view_matrix(pos, dir.Normalize(), Vector3d(0.0, 1.0, 0.0));
-	  lights_[i]->project_matrix(meshes_);
+void ShadowMap::ExportShadowMaps(const std::string &pattern) {
+  PROFILE_ZONE("ShadowMap::ExportShadowMaps");
+  PathPattern path_pattern;
+  if (!path_pattern.Parse(pattern)) {
+	printf("Invalid shadow map pattern %s.\n", pattern.c_str());
+	return;
+  }
+  if (export_thread_.joinable()) export_thread_.join();
+  // snapshot the maps here, the next shadow pass overwrites them
+  std::vector<ShadowImage> images;
+  for (int k = 0; k < lights_.size(); k++) {
+	ShadowBuffer *shadow_buffer = lights_[k]->shadow_buffer();
+	if (!shadow_buffer) continue;
+	ShadowImage image;
+	image.path = path_pattern.Format(k);
+	image.width = shadow_buffer->width();
+	image.height = shadow_buffer->height();
+	const unsigned char *texture = shadow_buffer->shadow_texture();
+	image.rgb.assign(texture, texture + 3 * image.width * image.height);
+	images.push_back(std::move(image));
+  }
+  export_thread_ = std::thread([images = std::move(images)]() {
+	PROFILE_ZONE("Shadow map export");
+	for (int i = 0; i < images.size(); i++) {
+	  const ShadowImage &image = images[i];
+	  if (!stbi_write_png(image.path.c_str(), image.width, image.height, 3, image.rgb.data(), 3 * image.width))
+		printf("Failed to write %s.\n", image.path.c_str());
 	}
+  });
+}
+
+void ShadowMap::BinMesh(ShadowPass *pass, int mesh_index) {
+  PROFILE_ZONE("Shadow binning");
+  const Mesh *mesh = meshes_[mesh_index];
+  const Vector3r *positions = pass->positions.data() + vertex_offsets_[mesh_index];
+  ShadowMeshPass &mesh_pass = pass->mesh_passes[mesh_index];
+  int width = pass->tile_grid.width(), height = pass->tile_grid.height();
+  ShadowRect &rect = mesh_pass.rect;
+  rect = ShadowRect{width, height, -1, -1};
+  for (int j = 0; j < mesh->indices.size(); j += 3) {
+	ShadowTriangle triangle;
+	triangle.a = positions[mesh->indices[j]];
+	triangle.b = positions[mesh->indices[j + 1]];
+	triangle.c = positions[mesh->indices[j + 2]];
+	const Vector3r &a = triangle.a, &b = triangle.b, &c = triangle.c;
+	triangle.x_min = std::max(static_cast<int>(floor(std::min(a.x, std::min(b.x, c.x)))), 0);
+	triangle.y_min = std::max(static_cast<int>(floor(std::min(a.y, std::min(b.y, c.y)))), 0);
+	triangle.x_max = std::min(static_cast<int>(ceil(std::max(a.x, std::max(b.x, c.x)))), width - 1);
+	triangle.y_max = std::min(static_cast<int>(ceil(std::max(a.y, std::max(b.y, c.y)))), height - 1);
+	if (triangle.x_min > triangle.x_max || triangle.y_min > triangle.y_max) continue;
+	mesh_pass.tile_grid.Bin(mesh_pass.triangles.size(), triangle.x_min, triangle.y_min,
+							triangle.x_max, triangle.y_max);
+	mesh_pass.triangles.push_back(triangle);
+	rect.x_min = std::min(rect.x_min, triangle.x_min);
+	rect.y_min = std::min(rect.y_min, triangle.y_min);
+	rect.x_max = std::max(rect.x_max, triangle.x_max);
+	rect.y_max = std::max(rect.y_max, triangle.y_max);
   }
 }
 
-// 目前没有透视校正，因为只支持方向光阴影
-void ShadowMap::SetShadowTexture(const VertexOut &p1,
-								 const VertexOut &p2,
-								 const VertexOut &p3,
-								 Light *light) {
-  Vector3d a(p1.pixel_position.x, p1.pixel_position.y, p1.pixel_position.z);
-  Vector3d b(p2.pixel_position.x, p2.pixel_position.y, p2.pixel_position.z);
-  Vector3d c(p3.pixel_position.x, p3.pixel_position.y, p3.pixel_position.z);
-
-  int x_min = floor(std::min(a.x, std::min(b.x, c.x)));
-  int y_min = floor(std::min(a.y, std::min(b.y, c.y)));
-  int x_max = ceil(std::max(a.x, std::max(b.x, c.x)));
-  int y_max = ceil(std::max(a.y, std::max(b.y, c.y)));
-
-  double alpha, beta, gamma, depth;
-
-  for (int y = y_min; y <= y_max; y++) {
-	for (int x = x_min; x <= x_max; x++) {
-	  if (Pipeline::InTriangle(Vector2d(x, y), a, b, c, alpha, beta, gamma)) {
-		depth = alpha * a.z + beta * b.z + gamma * c.z;
-		if (depth < light->shadow_buffer()->GetDepth(x, y))
-		  continue;
-		light->shadow_buffer()->SetDepth(x, y, depth);
-	  }
+void ShadowMap::MarkTiles(ShadowPass *pass, const ShadowRect &rect) {
+  for (int t = 0; t < pass->tile_grid.num_tiles(); t++) {
+	if (Overlaps(rect, pass->tile_grid.tile(t)))
+	  pass->dirty_tiles[t] = 1;
+  }
+}
+
+void ShadowMap::DrawTile(const ShadowPass &pass, int tile_index, ShadowBuffer *shadow_buffer) {
+  const Tile &tile = pass.tile_grid.tile(tile_index);
+  shadow_buffer->ClearRect(tile.x_min, tile.y_min, tile.x_max, tile.y_max);
+  for (int m = 0; m < pass.mesh_passes.size(); m++) {
+	const ShadowMeshPass &mesh_pass = pass.mesh_passes[m];
+	if (!Overlaps(mesh_pass.rect, tile)) continue;
+	const Tile &bin = mesh_pass.tile_grid.tile(tile_index);
+	for (int i = 0; i < bin.triangles.size(); i++) {
+	  const ShadowTriangle &triangle = mesh_pass.triangles[bin.triangles[i]];
+	  const Vector3r &a = triangle.a, &b = triangle.b, &c = triangle.c;
+	  RasterizeTriangle(a, b, c,
+						std::max(triangle.x_min, tile.x_min), std::max(triangle.y_min, tile.y_min),
+						std::min(triangle.x_max, tile.x_max), std::min(triangle.y_max, tile.y_max),
+						[&](int x, int y, Real alpha, Real beta, Real gamma) {
+		Real depth = alpha * a.z + beta * b.z + gamma * c.z;
+		if (depth < shadow_buffer->GetDepth(x, y))
+		  return;
+		shadow_buffer->SetDepth(x, y, depth);
+	  });
 	}
   }
 }
 
-VertexOut ShadowMap::TransformVertex(const VertexIn &in,
-									 const Matrix4d &model_matrix,
-									 Light *light) {
-  VertexOut out;
-  out.world_position = model_matrix * in.local_position;
-  out.view_position = light->view_matrix() * out.world_position;
-  out.clip_position = light->project_matrix() * out.view_position;
+Vector3r ShadowMap::TransformVertex(const VertexIn &in,
+									const Matrix4r &model_matrix,
+									const Light *light,
+									const Matrix4r &viewport_matrix) {
+  Vector4r world_position = model_matrix * in.local_position;
+  Vector4r view_position = light->view_matrix() * world_position;
+  Vector4r clip_position = light->project_matrix() * view_position;
   // z range from 0(far) to 1(near)
-  out.clip_position.z = (out.clip_position.z + 1.0) * 0.5;
-  return out;
-}
\ No newline at end of file
+  clip_position.z = (clip_position.z + 1.0) * 0.5;
+  Vector4r pixel_position = viewport_matrix * clip_position;
+  return Vector3r(pixel_position.x, pixel_position.y, pixel_position.z);
+}
@@ -5,77 +5,77 @@ Skybox::Skybox() {
   vertices_.resize(24);
   indices_.resize(36);
   // front
-  vertices_[0].pos = Vector4d(-0.5, 0.5, -0.5, 1.0);
-  vertices_[0].tex = Vector2d(0.0, 1.0);
+  vertices_[0].pos = Vector4r(-0.5, 0.5, -0.5, 1.0);
+  vertices_[0].tex = Vector2r(0.0, 1.0);
 
-  vertices_[1].pos = Vector4d(-0.5, -0.5, -0.5, 1.0);
-  vertices_[1].tex = Vector2d(0.0, 0.0);
+  vertices_[1].pos = Vector4r(-0.5, -0.5, -0.5, 1.0);
+  vertices_[1].tex = Vector2r(0.0, 0.0);
 
-  vertices_[2].pos = Vector4d(0.5, -0.5, -0.5, 1.0);
-  vertices_[2].tex = Vector2d(1.0, 0.0);
+  vertices_[2].pos = Vector4r(0.5, -0.5, -0.5, 1.0);
+  vertices_[2].tex = Vector2r(1.0, 0.0);
 
-  vertices_[3].pos = Vector4d(0.5, 0.5, -0.5, 1.0);
-  vertices_[3].tex = Vector2d(1.0, 1.0);
+  vertices_[3].pos = Vector4r(0.5, 0.5, -0.5, 1.0);
+  vertices_[3].tex = Vector2r(1.0, 1.0);
   //back
-  vertices_[4].pos = Vector4d(0.5, 0.5, 0.5, 1.0);
-  vertices_[4].tex = Vector2d(0.0, 1.0);
+  vertices_[4].pos = Vector4r(0.5, 0.5, 0.5, 1.0);
+  vertices_[4].tex = Vector2r(0.0, 1.0);
 
-  vertices_[5].pos = Vector4d(0.5, -0.5, 0.5, 1.0);
-  vertices_[5].tex = Vector2d(0.0, 0.0);
+  vertices_[5].pos = Vector4r(0.5, -0.5, 0.5, 1.0);
+  vertices_[5].tex = Vector2r(0.0, 0.0);
 
-  vertices_[6].pos = Vector4d(-0.5, -0.5, 0.5, 1.0);
-  vertices_[6].tex = Vector2d(1.0, 0.0);
+  vertices_[6].pos = Vector4r(-0.5, -0.5, 0.5, 1.0);
+  vertices_[6].tex = Vector2r(1.0, 0.0);
 
-  vertices_[7].pos = Vector4d(-0.5, 0.5, 0.5, 1.0);
-  vertices_[7].tex = Vector2d(1.0, 1.0);
+  vertices_[7].pos = Vector4r(-0.5, 0.5, 0.5, 1.0);
+  vertices_[7].tex = Vector2r(1.0, 1.0);
   // left
-  vertices_[8].pos = Vector4d(-0.5, 0.5, 0.5, 1.0);
-  vertices_[8].tex = Vector2d(0.0, 1.0);
+  vertices_[8].pos = Vector4r(-0.5, 0.5, 0.5, 1.0);
+  vertices_[8].tex = Vector2r(0.0, 1.0);
 
-  vertices_[9].pos = Vector4d(-0.5, -0.5, 0.5, 1.0);
-  vertices_[9].tex = Vector2d(0.0, 0.0);
+  vertices_[9].pos = Vector4r(-0.5, -0.5, 0.5, 1.0);
+  vertices_[9].tex = Vector2r(0.0, 0.0);
 
-  vertices_[10].pos = Vector4d(-0.5, -0.5, -0.5, 1.0);
-  vertices_[10].tex = Vector2d(1.0, 0.0);
+  vertices_[10].pos = Vector4r(-0.5, -0.5, -0.5, 1.0);
+  vertices_[10].tex = Vector2r(1.0, 0.0);
 
-  vertices_[11].pos = Vector4d(-0.5, 0.5, -0.5, 1.0);
-  vertices_[11].tex = Vector2d(1.0, 1.0);
+  vertices_[11].pos = Vector4r(-0.5, 0.5, -0.5, 1.0);
+  vertices_[11].tex = Vector2r(1.0, 1.0);
   // right
-  vertices_[12].pos = Vector4d(0.5, 0.5, -0.5, 1.0);
-  vertices_[12].tex = Vector2d(0.0, 1.0);
+  vertices_[12].pos = Vector4r(0.5, 0.5, -0.5, 1.0);
+  vertices_[12].tex = Vector2r(0.0, 1.0);
 
-  vertices_[13].pos = Vector4d(0.5, -0.5, -0.5, 1.0);
-  vertices_[13].tex = Vector2d(0.0, 0.0);
+  vertices_[13].pos = Vector4r(0.5, -0.5, -0.5, 1.0);
+  vertices_[13].tex = Vector2r(0.0, 0.0);
 
-  vertices_[14].pos = Vector4d(0.5, -0.5, 0.5, 1.0);
-  vertices_[14].tex = Vector2d(1.0, 0.0);
+  vertices_[14].pos = Vector4r(0.5, -0.5, 0.5, 1.0);
+  vertices_[14].tex = Vector2r(1.0, 0.0);
 
-  vertices_[15].pos = Vector4d(0.5, 0.5, 0.5, 1.0);
-  vertices_[15].tex = Vector2d(1.0, 1.0);
+  vertices_[15].pos = Vector4r(0.5, 0.5, 0.5, 1.0);
+  vertices_[15].tex = Vector2r(1.0, 1.0);
   // up
-  vertices_[16].pos = Vector4d(-0.5, 0.5, 0.5, 1.0);
-  vertices_[16].tex = Vector2d(0.0, 1.0);
+  vertices_[16].pos = Vector4r(-0.5, 0.5, 0.5, 1.0);
+  vertices_[16].tex = Vector2r(0.0, 1.0);
 
-  vertices_[17].pos = Vector4d(-0.5, 0.5, -0.5, 1.0);
-  vertices_[17].tex = Vector2d(0.0, 0.0);
+  vertices_[17].pos = Vector4r(-0.5, 0.5, -0.5, 1.0);
+  vertices_[17].tex = Vector2r(0.0, 0.0);
 
-  vertices_[18].pos = Vector4d(0.5, 0.5, -0.5, 1.0);
-  vertices_[18].tex = Vector2d(1.0, 0.0);
+  vertices_[18].pos = Vector4r(0.5, 0.5, -0.5, 1.0);
+  vertices_[18].tex = Vector2r(1.0, 0.0);
 
-  vertices_[19].pos = Vector4d(0.5, 0.5, 0.5, 1.0);
-  vertices_[19].tex = Vector2d(1.0, 1.0);
+  vertices_[19].pos = Vector4r(0.5, 0.5, 0.5, 1.0);
+  vertices_[19].tex = Vector2r(1.0, 1.0);
   // down
-  vertices_[20].pos = Vector4d(-0.5, -0.5, -0.5, 1.0);
-  vertices_[20].tex = Vector2d(0.0, 1.0);
+  vertices_[20].pos = Vector4r(-0.5, -0.5, -0.5, 1.0);
+  vertices_[20].tex = Vector2r(0.0, 1.0);
 
-  vertices_[21].pos = Vector4d(-0.5, -0.5, 0.5, 1.0);
-  vertices_[21].tex = Vector2d(0.0, 0.0);
+  vertices_[21].pos = Vector4r(-0.5, -0.5, 0.5, 1.0);
+  vertices_[21].tex = Vector2r(0.0, 0.0);
 
-  vertices_[22].pos = Vector4d(0.5, -0.5, 0.5, 1.0);
-  vertices_[22].tex = Vector2d(1.0, 0.0);
+  vertices_[22].pos = Vector4r(0.5, -0.5, 0.5, 1.0);
+  vertices_[22].tex = Vector2r(1.0, 0.0);
 
-  vertices_[23].pos = Vector4d(0.5, -0.5, -0.5, 1.0);
-  vertices_[23].tex = Vector2d(1.0, 1.0);
+  vertices_[23].pos = Vector4r(0.5, -0.5, -0.5, 1.0);
+  vertices_[23].tex = Vector2r(1.0, 1.0);
   // init indices
   // front
   indices_[0] = 0;
@@ -136,7 +136,7 @@ void Skybox::LoadSkybox(const std::string &path) {
   skybox_[5].LoadImage((path + "_dn.png").c_str());
 }
 
-Vector4d Skybox::Sample(const Vector2d &uv, Face face) {
+Vector4r Skybox::Sample(const Vector2r &uv, Face face) {
   switch (face) {
 	case Face::kFront:return skybox_[0].Sample(uv);
 	case Face::kBack: return skybox_[1].Sample(uv);
@@ -147,11 +147,11 @@ Vector4d Skybox::Sample(const Vector2d &uv, Face face) {
   }
 }
 
-Vector4d Skybox::TransformPos(const Matrix4d &viewport,
-							  const Matrix4d &project,
-							  const Matrix4d &view,
-							  const Vector4d &pos) {
-  Vector4d res = project * (view * pos);
+Vector4r Skybox::TransformPos(const Matrix4r &viewport,
+							  const Matrix4r &project,
+							  const Matrix4r &view,
+							  const Vector4r &pos) {
+  Vector4r res = project * (view * pos);
   res /= res.w;
   res.z = 1.0;
   res.w = 1.0;
@@ -10,15 +10,15 @@ Texture::~Texture() {
 }
 
 // use texture coordinate to get texture color
-Vector4d Texture::Sample(const Vector2d &tex) {
-  if (!data_) return Vector4d{};
+Vector4r Texture::Sample(const Vector2r &tex) {
+  if (!data_) return Vector4r{};
   // u and v range from 0 to 1
-  double u = tex.x - floor(tex.x);
-  double v = tex.y - floor(tex.y);
+  Real u = tex.x - floor(tex.x);
+  Real v = tex.y - floor(tex.y);
   int x = static_cast<int>(u * (width_ - 1));
   int y = static_cast<int>(v * (height_ - 1));
   int index = (y * width_ + x) * channels_;
-  return Vector4d(*(data_ + index), *(data_ + index + 1), *(data_ + index + 2), 0.0);
+  return Vector4r(*(data_ + index), *(data_ + index + 1), *(data_ + index + 2), 0.0);
 }
 
 bool Texture::LoadImage(const char *path) {
@@ -0,0 +1,72 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int num_threads)
+	: job_(nullptr), count_(0), next_(0), active_(0), generation_(0), stop_(false) {
+  if (num_threads <= 0)
+	num_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  // the thread calling ParallelFor works too
+  for (int i = 1; i < num_threads; i++)
+	workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+	std::lock_guard<std::mutex> lock(mutex_);
+	stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (int i = 0; i < workers_.size(); i++)
+	workers_[i].join();
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)> &func) {
+  if (count <= 0) return;
+  if (workers_.empty() || count == 1) {
+	for (int i = 0; i < count; i++)
+	  func(i);
+	return;
+  }
+
+  {
+	std::lock_guard<std::mutex> lock(mutex_);
+	job_ = &func;
+	count_ = count;
+	next_ = 0;
+	active_ = static_cast<int>(workers_.size());
+	generation_++;
+  }
+  start_cv_.notify_all();
+
+  RunJob();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return active_ == 0; });
+  job_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+  unsigned generation = 0;
+  while (true) {
+	{
+	  std::unique_lock<std::mutex> lock(mutex_);
+	  start_cv_.wait(lock, [this, generation] { return stop_ || generation_ != generation; });
+	  if (stop_) return;
+	  generation = generation_;
+	}
+	RunJob();
+	{
+	  std::lock_guard<std::mutex> lock(mutex_);
+	  if (--active_ == 0)
+		done_cv_.notify_one();
+	}
+  }
+}
+
+void ThreadPool::RunJob() {
+  // job_ and count_ do not change until every worker has reported back
+  int i;
+  while ((i = next_.fetch_add(1)) < count_)
+	(*job_)(i);
+}
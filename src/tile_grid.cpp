@@ -0,0 +1,41 @@
+#include "tile_grid.h"
+
+#include <algorithm>
+
+TileGrid::TileGrid(int width, int height)
+	: width_(width),
+	  height_(height),
+	  num_x_((width + kTileSize - 1) / kTileSize),
+	  num_y_((height + kTileSize - 1) / kTileSize) {
+  tiles_.resize(num_x_ * num_y_);
+  for (int ty = 0; ty < num_y_; ty++) {
+	for (int tx = 0; tx < num_x_; tx++) {
+	  Tile &tile = tiles_[ty * num_x_ + tx];
+	  tile.x_min = tx * kTileSize;
+	  tile.y_min = ty * kTileSize;
+	  tile.x_max = std::min(tile.x_min + kTileSize, width_) - 1;
+	  tile.y_max = std::min(tile.y_min + kTileSize, height_) - 1;
+	}
+  }
+}
+
+void TileGrid::Clear() {
+  // keep the capacity, bins are refilled every frame
+  for (int i = 0; i < tiles_.size(); i++)
+	tiles_[i].triangles.clear();
+}
+
+void TileGrid::Bin(int id, int x_min, int y_min, int x_max, int y_max) {
+  // rectangles outside the screen touch no tile
+  if (x_max < 0 || y_max < 0 || x_min >= width_ || y_min >= height_)
+	return;
+  int tx_min = std::max(x_min, 0) / kTileSize;
+  int ty_min = std::max(y_min, 0) / kTileSize;
+  int tx_max = std::min(x_max, width_ - 1) / kTileSize;
+  int ty_max = std::min(y_max, height_ - 1) / kTileSize;
+  for (int ty = ty_min; ty <= ty_max; ty++) {
+	for (int tx = tx_min; tx <= tx_max; tx++) {
+	  tiles_[ty * num_x_ + tx].triangles.push_back(id);
+	}
+  }
+}
@@ -1,6 +1,9 @@
 #include "window.h"
+#include <cstdio>
 #include <vector>
 
+#include "profiler.h"
+
 Window::Window(int width, int height)
 	: width_(width),
 	  height_(height),
@@ -17,7 +20,6 @@ Window::Window(int width, int height)
   pipeline_ = new Pipeline(width, height);
   scene_ = new Scene();
   LoadScene();
-  pipeline_->RenderShadowMap();
 }
 
 Window::~Window() {
@@ -35,20 +37,26 @@ Window::~Window() {
 
 void Window::Show() {
   while (true) {
+	PROFILE_ZONE("Frame");
 	EventResponse(scene_->camera());
 
 	scene_->camera()->UpdateView();
 	pipeline_->SetCamera(scene_->camera());
+	// only what moved since the last frame is redrawn
+	pipeline_->RenderShadowMap();
 
-	pipeline_->ClearBuffer(Vector4d(0, 0, 0, 1.0));
+	pipeline_->ClearBuffer(Vector4r(0, 0, 0, 1.0));
 	pipeline_->Draw(mode_);
 	pipeline_->SwapBuffer();
 
 	unsigned char *color_buffer = pipeline_->ColorBuffer();
 
-    SDL_UpdateTexture(texture_, NULL, color_buffer, width_ * 4);
-	SDL_RenderCopy(renderer_, texture_, NULL, NULL);
-	SDL_RenderPresent(renderer_);
+	{
+	  PROFILE_ZONE("Present");
+	  SDL_UpdateTexture(texture_, NULL, color_buffer, width_ * 4);
+	  SDL_RenderCopy(renderer_, texture_, NULL, NULL);
+	  SDL_RenderPresent(renderer_);
+	}
 
 	ShowFPS();
   }
@@ -88,6 +96,20 @@ void Window::EventResponse(Camera *camera) {
 		  else
 			mode_ = RenderMode::kLine;
 		  SwitchRenderMode();
+		} else if (event_.key.keysym.sym == SDLK_g) {
+		  if (mode_ == RenderMode::kDeferred)
+			break;
+		  else
+			mode_ = RenderMode::kDeferred;
+		  SwitchRenderMode();
+		} else if (event_.key.keysym.sym == SDLK_z) {
+		  pipeline_->set_depth_prepass(!pipeline_->depth_prepass());
+		} else if (event_.key.keysym.sym == SDLK_m) {
+		  pipeline_->ExportShadowMaps("shadow_map%d.png");
+		} else if (event_.key.keysym.sym == SDLK_t) {
+		  // dump the zones recorded so far
+		  if (kProfilingEnabled && Profiler::WriteChromeTrace("trace.json"))
+			printf("Wrote trace.json\n");
 		} else if (event_.key.keysym.sym == SDLK_ESCAPE) {
 		  UnLoadScene();
 		  exit(0);
@@ -107,7 +129,7 @@ void Window::ShowFPS() {
   delta_time_ = curr_time_ - prev_time_;
   prev_time_ = curr_time_;
   if (frame_ % 10 == 0) {
-	sprintf_s(title_, " FPS: %d", static_cast<int>(1000.0 / delta_time_));
+	snprintf(title_, sizeof(title_), " FPS: %d", static_cast<int>(1000.0 / delta_time_));
 	SDL_SetWindowTitle(window_, title_);
   }
   frame_++;
@@ -142,7 +164,9 @@ void Window::SetCamera() {
 void Window::SetLights() {
   std::vector<Light*> &lights = scene_->lights();
   for (int i = 0; i < lights.size(); i++) {
-	lights[i]->shadow_buffer(width_, height_);
+	int shadow_width = lights[i]->shadow_width() > 0 ? lights[i]->shadow_width() : width_;
+	int shadow_height = lights[i]->shadow_height() > 0 ? lights[i]->shadow_height() : height_;
+	lights[i]->shadow_buffer(shadow_width, shadow_height);
 	lights[i]->shadow_buffer()->ClearBuffer();
 	pipeline_->AddLight(lights[i]);
   }